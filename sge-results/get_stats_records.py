@@ -0,0 +1,57 @@
+#!/bin/env python
+
+# obtain records of given type from NDJSON stats files (see --stats-file)
+# downpath current folder, the files to be processed are those whose names
+# begin with given prefix and end with given suffix. Records are printed
+# as CSV with a header line made of the union of all field names.
+
+from __future__ import print_function
+
+import csv
+import json
+import os
+import sys
+
+if len(sys.argv) != 4:
+    print("Usage: %s <record-type> <filename-prefix> <filename-suffix>\n" % sys.argv[0])
+    print("Extracts records of given type (decision, step, or episode) from")
+    print("NDJSON stats files downpath the current folder. The processed files")
+    print("are those whose names begin with given prefix and end with given suffix.")
+    exit(-1)
+
+record_type = sys.argv[1]
+filename_prefix = sys.argv[2]
+filename_suffix = sys.argv[3]
+
+# flatten nested values so that they fit in a single CSV column
+def flatten(value):
+    if isinstance(value, (list, dict)):
+        return json.dumps(value, separators=(',', ':'))
+    return value
+
+# recurse in current dir processing files whose name begin with given prefix
+# and end with given suffix
+records = []
+fields = ["filename"]
+for root, dirs, files in os.walk("."):
+    for filename in files:
+        if filename[:len(filename_prefix)] == filename_prefix and filename[-len(filename_suffix):] == filename_suffix:
+            filename = "%s/%s" % (root, filename)
+            with open(filename) as fp:
+                for line in fp:
+                    try:
+                        record = json.loads(line)
+                    except ValueError:
+                        continue # truncated last line of unfinished run
+                    if record.get("type") == record_type:
+                        record["filename"] = filename
+                        for key in record:
+                            if key not in fields:
+                                fields.append(key)
+                        records.append(record)
+
+writer = csv.DictWriter(sys.stdout, fieldnames=fields)
+writer.writeheader()
+for record in records:
+    writer.writerow(dict((key, flatten(value)) for key, value in record.items()))
+
@@ -0,0 +1,126 @@
+// (c) 2017 Blai Bonet
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include "async_log.h"
+
+AsyncLogWriter* AsyncLogWriter::current_ = nullptr;
+size_t AsyncLogWriter::num_generations_ = 0;
+thread_local AsyncLogWriter::Producer* AsyncLogWriter::thread_producer_ = nullptr;
+thread_local size_t AsyncLogWriter::thread_producer_generation_ = 0;
+
+AsyncLogWriter::AsyncLogWriter(std::ostream &output_stream, size_t ring_size, policy_t policy)
+  : output_stream_(output_stream),
+    ring_size_(ring_size),
+    policy_(policy),
+    generation_(++num_generations_),
+    stop_(false),
+    dropped_messages_(0),
+    dropped_bytes_(0) {
+    // ring size must be a power of two
+    assert(ring_size_ > 0);
+    assert((ring_size_ & (ring_size_ - 1)) == 0);
+    assert(current_ == nullptr);
+    current_ = this;
+    writer_thread_ = std::thread(&AsyncLogWriter::run, this);
+}
+
+AsyncLogWriter::~AsyncLogWriter() {
+    // producers must be quiescent at this point: commit what is staged
+    std::vector<Producer*> producers;
+    {
+        std::lock_guard<std::mutex> lock(producers_mutex_);
+        producers = producers_;
+    }
+    for( size_t k = 0; k < producers.size(); ++k )
+        producers[k]->buffer_.commit();
+
+    stop_.store(true, std::memory_order_release);
+    writer_thread_.join();
+    drain();
+    output_stream_.flush();
+    for( size_t k = 0; k < producers_.size(); ++k )
+        delete producers_[k];
+    current_ = nullptr;
+}
+
+std::ostream& AsyncLogWriter::thread_stream() {
+    assert(current_ != nullptr);
+    if( (thread_producer_ == nullptr) || (thread_producer_generation_ != current_->generation_) ) {
+        thread_producer_ = &current_->register_producer();
+        thread_producer_generation_ = current_->generation_;
+    }
+    return thread_producer_->stream_;
+}
+
+AsyncLogWriter::Producer& AsyncLogWriter::register_producer() {
+    Producer *producer = new Producer(*this, ring_size_);
+    std::lock_guard<std::mutex> lock(producers_mutex_);
+    producers_.push_back(producer);
+    return *producer;
+}
+
+void AsyncLogWriter::push(Ring &ring, const char *data, size_t n) {
+    if( (n > ring.capacity()) && (policy_ == Drop) ) {
+        dropped_messages_.fetch_add(1, std::memory_order_relaxed);
+        dropped_bytes_.fetch_add(n, std::memory_order_relaxed);
+        return;
+    }
+
+    // in drop mode, a message is pushed whole or dropped whole (it fits in
+    // the ring); in blocking mode, messages larger than the ring are pushed
+    // in pieces
+    while( n > 0 ) {
+        size_t chunk = n < ring.capacity() ? n : ring.capacity();
+        size_t head = ring.head_.load(std::memory_order_relaxed);
+        while( ring.capacity() - (head - ring.tail_.load(std::memory_order_acquire)) < chunk ) {
+            if( policy_ == Drop ) {
+                dropped_messages_.fetch_add(1, std::memory_order_relaxed);
+                dropped_bytes_.fetch_add(n, std::memory_order_relaxed);
+                return;
+            }
+            std::this_thread::yield();
+        }
+
+        size_t offset = head & ring.mask_;
+        size_t first = chunk < ring.capacity() - offset ? chunk : ring.capacity() - offset;
+        std::copy(data, data + first, &ring.buffer_[offset]);
+        std::copy(data + first, data + chunk, &ring.buffer_[0]);
+        ring.head_.store(head + chunk, std::memory_order_release);
+
+        data += chunk;
+        n -= chunk;
+    }
+}
+
+size_t AsyncLogWriter::drain() {
+    size_t total = 0;
+    std::lock_guard<std::mutex> lock(producers_mutex_);
+    for( size_t k = 0; k < producers_.size(); ++k ) {
+        Ring &ring = producers_[k]->ring_;
+        size_t tail = ring.tail_.load(std::memory_order_relaxed);
+        size_t head = ring.head_.load(std::memory_order_acquire);
+        if( head == tail ) continue;
+
+        // write contents of ring (possibly wrapped around) as one batch
+        size_t n = head - tail;
+        size_t offset = tail & ring.mask_;
+        size_t first = n < ring.capacity() - offset ? n : ring.capacity() - offset;
+        output_stream_.write(&ring.buffer_[offset], first);
+        if( n > first ) output_stream_.write(&ring.buffer_[0], n - first);
+        ring.tail_.store(head, std::memory_order_release);
+        total += n;
+    }
+    return total;
+}
+
+void AsyncLogWriter::run() {
+    while( !stop_.load(std::memory_order_acquire) ) {
+        if( drain() == 0 ) {
+            output_stream_.flush();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
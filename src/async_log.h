@@ -0,0 +1,131 @@
+// (c) 2017 Blai Bonet
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Asynchronous backend for Logger. Each producer thread formats its
+// messages into its own std::ostream whose buffer is committed, on every
+// flush (std::endl, std::flush), into a lock-free
+// single-producer/single-consumer ring. The buffer grows as needed until
+// the flush, so each commit pushes a whole message. A background thread drains the
+// rings in batches and writes them to the output stream, so planning
+// threads never perform file I/O. Messages of each thread keep their
+// order. When a ring is full the producer either waits for the writer
+// (Block) or discards the whole message and counts it (Drop); memory is
+// bounded by the ring size times the number of producer threads (plus
+// the buffer of each thread, as big as its longest message).
+
+class AsyncLogWriter {
+  public:
+    enum policy_t {
+      Block = 0,
+      Drop = 1
+    };
+
+    AsyncLogWriter(std::ostream &output_stream, size_t ring_size, policy_t policy);
+    ~AsyncLogWriter();
+
+    // stream for calling thread, installed as Logger's output stream provider
+    static std::ostream& thread_stream();
+
+    size_t dropped_messages() const {
+        return dropped_messages_.load(std::memory_order_relaxed);
+    }
+    size_t dropped_bytes() const {
+        return dropped_bytes_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    struct Ring {
+        std::vector<char> buffer_;
+        size_t mask_;
+        std::atomic<size_t> head_; // written only by producer
+        std::atomic<size_t> tail_; // written only by writer thread
+        Ring(size_t size) : buffer_(size), mask_(size - 1), head_(0), tail_(0) { }
+        size_t capacity() const {
+            return buffer_.size();
+        }
+    };
+
+    class ProducerBuffer : public std::streambuf {
+      public:
+        ProducerBuffer(AsyncLogWriter &writer, Ring &ring)
+          : writer_(writer),
+            ring_(ring),
+            staging_(1024) {
+            setp(&staging_[0], &staging_[0] + staging_.size());
+        }
+        void commit() {
+            size_t n = pptr() - pbase();
+            if( n > 0 ) writer_.push(ring_, pbase(), n);
+            setp(&staging_[0], &staging_[0] + staging_.size());
+        }
+
+      protected:
+        // message doesn't fit: double staging buffer (kept for next messages)
+        virtual int_type overflow(int_type c) {
+            size_t n = pptr() - pbase();
+            staging_.resize(2 * staging_.size());
+            setp(&staging_[0], &staging_[0] + staging_.size());
+            pbump(int(n));
+            if( !traits_type::eq_int_type(c, traits_type::eof()) ) {
+                *pptr() = traits_type::to_char_type(c);
+                pbump(1);
+            }
+            return traits_type::not_eof(c);
+        }
+        virtual int sync() {
+            commit();
+            return 0;
+        }
+
+      private:
+        AsyncLogWriter &writer_;
+        Ring &ring_;
+        std::vector<char> staging_;
+    };
+
+    struct Producer {
+        Ring ring_;
+        ProducerBuffer buffer_;
+        std::ostream stream_;
+        Producer(AsyncLogWriter &writer, size_t ring_size)
+          : ring_(ring_size),
+            buffer_(writer, ring_),
+            stream_(&buffer_) {
+        }
+    };
+
+    std::ostream &output_stream_;
+    const size_t ring_size_;
+    const policy_t policy_;
+    const size_t generation_;
+
+    std::mutex producers_mutex_; // held only to register producers and to drain
+    std::vector<Producer*> producers_;
+    std::atomic<bool> stop_;
+    std::atomic<size_t> dropped_messages_;
+    std::atomic<size_t> dropped_bytes_;
+    std::thread writer_thread_;
+
+    static AsyncLogWriter *current_;
+    static size_t num_generations_;
+    static thread_local Producer *thread_producer_;
+    static thread_local size_t thread_producer_generation_;
+
+    Producer& register_producer();
+    void push(Ring &ring, const char *data, size_t n);
+    size_t drain();
+    void run();
+};
+
+#endif
+
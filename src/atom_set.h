@@ -0,0 +1,142 @@
+// (c) 2017 Blai Bonet
+
+#ifndef ATOM_SET_H
+#define ATOM_SET_H
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include "utils.h"
+
+// Compressed, immutable set of feature atoms. Atoms are sorted and stored
+// as a varint-encoded sequence of deltas (the first delta is the first
+// atom), which takes 1-3 bytes per atom instead of 4. Atoms are decoded
+// into a caller-provided scratch vector when needed. The encoding is
+// canonical, so two sets are equal iff their encodings are equal, and
+// the encoding of a set can be shared (reference counted) between nodes,
+// e.g. along frame-repetition chains. Since atom indices of basic features
+// are smaller than those of B-PROS and B-PROT features, basic atoms form
+// a prefix of the decoded atoms. Fingerprints are hashes of atom vectors
+// that do not depend on the order of atoms.
+
+class AtomSet {
+  public:
+    AtomSet() { }
+
+    bool empty() const {
+        return blob_ == nullptr;
+    }
+    size_t size() const {
+        return blob_ == nullptr ? 0 : blob_->num_atoms_;
+    }
+    // heap bytes held by encoding (shared encodings are counted by each holder)
+    size_t bytes() const {
+        return blob_ == nullptr ? 0 : sizeof(blob_t) + blob_->bytes_.capacity();
+    }
+    bool shares(const AtomSet &other) const {
+        return (blob_ != nullptr) && (blob_ == other.blob_);
+    }
+    bool operator==(const AtomSet &other) const {
+        if( blob_ == other.blob_ ) return true;
+        if( (blob_ == nullptr) || (other.blob_ == nullptr) ) return false;
+        return (blob_->num_atoms_ == other.blob_->num_atoms_) && (blob_->bytes_ == other.blob_->bytes_);
+    }
+
+    void clear() {
+        blob_.reset();
+    }
+    void share(const AtomSet &other) {
+        blob_ = other.blob_;
+    }
+
+    // encode atoms; they are sorted in place
+    void assign(std::vector<int> &atoms) {
+        std::sort(atoms.begin(), atoms.end());
+        std::shared_ptr<blob_t> blob = std::make_shared<blob_t>();
+        std::vector<unsigned char> &bytes = blob->bytes_;
+        bytes.reserve(2 * atoms.size());
+        int last = 0;
+        for( size_t k = 0; k < atoms.size(); ++k ) {
+            assert((atoms[k] >= last) && ((k == 0) || (atoms[k] > last)));
+            uint32_t delta = atoms[k] - last;
+            while( delta >= 0x80 ) {
+                bytes.push_back((delta & 0x7F) | 0x80);
+                delta >>= 7;
+            }
+            bytes.push_back(delta);
+            last = atoms[k];
+        }
+        bytes.shrink_to_fit();
+        blob->num_atoms_ = atoms.size();
+        blob_ = blob;
+    }
+
+    // keep atoms smaller than bound, which are a prefix of the encoding;
+    // the encoding is replaced (not modified) so sharers are unaffected
+    void trim(int bound) {
+        if( blob_ == nullptr ) return;
+        const unsigned char *begin = blob_->bytes_.data();
+        const unsigned char *p = begin;
+        int last = 0;
+        size_t k = 0;
+        for( ; k < blob_->num_atoms_; ++k ) {
+            const unsigned char *q = p;
+            uint32_t delta = *q & 0x7F;
+            for( int shift = 7; *q++ & 0x80; shift += 7 )
+                delta |= uint32_t(*q & 0x7F) << shift;
+            if( last + int(delta) >= bound ) break;
+            last += delta;
+            p = q;
+        }
+        if( k == blob_->num_atoms_ ) return;
+        std::shared_ptr<blob_t> blob = std::make_shared<blob_t>();
+        blob->num_atoms_ = k;
+        blob->bytes_ = std::vector<unsigned char>(begin, p);
+        blob_ = blob;
+    }
+
+    // order-independent hash of atoms (never 0, which stands for none)
+    static uint64_t fingerprint(const std::vector<int> &atoms) {
+        uint64_t h = 0;
+        for( size_t k = 0; k < atoms.size(); ++k )
+            h += Utils::mix64(uint32_t(atoms[k]));
+        return Utils::mix64(h) | 1;
+    }
+    static uint64_t fingerprint(uint64_t h1, uint64_t h2) {
+        return Utils::mix64(h1 ^ Utils::mix64(h2 + 0x9E3779B97F4A7C15ULL)) | 1;
+    }
+
+    // decode atoms smaller than bound (all by default) into atoms
+    void decode(std::vector<int> &atoms, int bound = std::numeric_limits<int>::max()) const {
+        atoms.clear();
+        if( blob_ == nullptr ) return;
+        atoms.resize(blob_->num_atoms_);
+        const unsigned char *p = blob_->bytes_.data();
+        int last = 0;
+        for( size_t k = 0; k < blob_->num_atoms_; ++k ) {
+            uint32_t delta = *p & 0x7F;
+            for( int shift = 7; *p++ & 0x80; shift += 7 )
+                delta |= uint32_t(*p & 0x7F) << shift;
+            last += delta;
+            if( last >= bound ) {
+                atoms.resize(k);
+                break;
+            }
+            atoms[k] = last;
+        }
+    }
+
+  private:
+    struct blob_t {
+        size_t num_atoms_;
+        std::vector<unsigned char> bytes_;
+    };
+    std::shared_ptr<const blob_t> blob_;
+};
+
+#endif
+
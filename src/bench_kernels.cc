@@ -0,0 +1,499 @@
+// (c) 2017 Blai Bonet
+
+// Microbenchmarks for the kernels of the width-based planners, measured in
+// isolation on a corpus of recorded states. The corpus is made of the
+// states, RAMs, and screens along a random walk in the game; it is recorded
+// on first use and saved to the given file, so that later runs (e.g. before
+// and after an optimization) time the kernels on identical inputs.
+//
+// Usage: bench_kernels [--corpus <file>] [--states <n>] [--reps <n>]
+//                      [--tree-nodes <n>] [--frameskip <n>] [--seed <n>] <rom>
+//
+// Each kernel is reported as ns/op and ops/s (throughput).
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <queue>
+#include <string>
+#include <vector>
+#include <ale_interface.hpp>
+
+#include "atom_set.h"
+#include "frontier.h"
+#include "logger.h"
+#include "node.h"
+#include "random.h"
+#include "screen.h"
+#include "sim_planner.h"
+
+using namespace std;
+
+vector<pixel_t> MyALEScreen::background_;
+size_t MyALEScreen::num_background_pixels_;
+ActionVect MyALEScreen::minimal_actions_;
+size_t MyALEScreen::minimal_actions_size_;
+
+// planner exposing the kernels of SimPlanner
+struct KernelPlanner : SimPlanner {
+    KernelPlanner(ALEInterface &sim, size_t frameskip, size_t num_tracked_atoms)
+      : SimPlanner(sim, frameskip, true, 0, num_tracked_atoms) {
+    }
+    virtual ~KernelPlanner() { }
+
+    virtual std::string name() const {
+        return std::string("kernels()");
+    }
+    virtual bool random_decision() const {
+        return false;
+    }
+    virtual size_t height() const {
+        return 0;
+    }
+    virtual size_t expanded() const {
+        return 0;
+    }
+    virtual Node* get_branch(ALEInterface &env,
+                             const std::vector<Action> &prefix,
+                             Node *root,
+                             float last_reward,
+                             std::deque<Action> &branch) const {
+        assert(0);
+        return nullptr;
+    }
+};
+
+// recorded state: serialized ALE state, and RAM and screen after reaching it
+struct sample_t {
+    string state_;
+    vector<byte_t> ram_;
+    vector<pixel_t> screen_;
+};
+
+// size of novelty tables, as given by the feature-mode policies
+static size_t num_tracked_atoms(int features) {
+    switch( features ) {
+        case 0: return Features::RAM::num_atoms_;
+        case 1: return Features::Basic::num_atoms_;
+        case 2: return Features::Bpros::num_atoms_;
+        case 3: return Features::Bprot::num_atoms_;
+        case 4: return Features::RamBits::num_atoms_;
+        default: return 0;
+    }
+}
+
+static void record_corpus(ALEInterface &ale, size_t num_states, Random::Engine &rng, vector<sample_t> &corpus) {
+    ActionVect actions = ale.getMinimalActionSet();
+    ale.reset_game();
+    while( corpus.size() < num_states ) {
+        if( ale.game_over() ) ale.reset_game();
+        ale.act(actions[rng.uniform(actions.size())]);
+        corpus.push_back(sample_t());
+        sample_t &sample = corpus.back();
+        sample.state_ = ale.cloneState().serialize();
+        const ALERAM &ram = ale.getRAM();
+        for( size_t k = 0; k < 128; ++k )
+            sample.ram_.push_back(ram.get(k));
+        const ALEScreen &screen = ale.getScreen();
+        sample.screen_ = vector<pixel_t>(screen.getArray(), screen.getArray() + screen.height() * screen.width());
+    }
+}
+
+// corpus file: #samples, then for each sample the length-prefixed serialized
+// state followed by 128 bytes of RAM and 210x160 bytes of screen
+static bool save_corpus(const string &filename, const vector<sample_t> &corpus) {
+    ofstream os(filename.c_str(), ios::binary);
+    uint64_t n = corpus.size();
+    os.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    for( size_t k = 0; k < corpus.size(); ++k ) {
+        uint64_t len = corpus[k].state_.size();
+        os.write(reinterpret_cast<const char*>(&len), sizeof(len));
+        os.write(corpus[k].state_.data(), len);
+        os.write(reinterpret_cast<const char*>(&corpus[k].ram_[0]), corpus[k].ram_.size());
+        os.write(reinterpret_cast<const char*>(&corpus[k].screen_[0]), corpus[k].screen_.size());
+    }
+    return bool(os);
+}
+
+static bool load_corpus(const string &filename, vector<sample_t> &corpus) {
+    ifstream is(filename.c_str(), ios::binary);
+    uint64_t n = 0;
+    if( !is.read(reinterpret_cast<char*>(&n), sizeof(n)) ) return false;
+    corpus = vector<sample_t>(n);
+    for( size_t k = 0; k < n; ++k ) {
+        uint64_t len = 0;
+        is.read(reinterpret_cast<char*>(&len), sizeof(len));
+        corpus[k].state_ = string(len, '\0');
+        corpus[k].ram_ = vector<byte_t>(128);
+        corpus[k].screen_ = vector<pixel_t>(MyALEScreen::width_ * MyALEScreen::height_);
+        is.read(&corpus[k].state_[0], len);
+        is.read(reinterpret_cast<char*>(&corpus[k].ram_[0]), corpus[k].ram_.size());
+        is.read(reinterpret_cast<char*>(&corpus[k].screen_[0]), corpus[k].screen_.size());
+    }
+    return bool(is);
+}
+
+struct Timer {
+    chrono::steady_clock::time_point start_;
+    double elapsed_;
+    Timer() : elapsed_(0) { }
+    void start() {
+        start_ = chrono::steady_clock::now();
+    }
+    void stop() {
+        elapsed_ += chrono::duration<double>(chrono::steady_clock::now() - start_).count();
+    }
+};
+
+static void report(const string &kernel, size_t ops, double elapsed) {
+    cout << "bench-kernels: " << left << setw(28) << kernel << right
+         << " ops=" << setw(9) << ops
+         << " ns/op=" << setw(12) << fixed << setprecision(1) << (ops == 0 ? 0 : 1e9 * elapsed / ops)
+         << " ops/s=" << setw(14) << setprecision(0) << (elapsed == 0 ? 0 : ops / elapsed)
+         << defaultfloat << setprecision(6) << endl;
+}
+
+// reference two-pass novelty kernels (what the planners did before the
+// fused SimPlanner::check_and_update_novelty): first pass looks for an atom
+// with table entry above depth, second for an atom with entry equal to depth
+template<typename T>
+static size_t update_novelty_table(size_t depth, const vector<int> &feature_atoms, NoveltyTable<T> &novelty_table) {
+    int d = SimPlanner::table_depth<T>(depth);
+    size_t number_updated_entries = 0;
+    for( size_t k = 0; k < feature_atoms.size(); ++k ) {
+        assert((feature_atoms[k] >= 0) && (feature_atoms[k] < int(novelty_table.size())));
+        if( d < novelty_table.depth(feature_atoms[k]) ) {
+            novelty_table.set_depth(feature_atoms[k], d);
+            ++number_updated_entries;
+        }
+    }
+    return number_updated_entries;
+}
+
+template<typename T>
+static int get_novel_atom(size_t depth, const vector<int> &feature_atoms, const NoveltyTable<T> &novelty_table) {
+    assert(!feature_atoms.empty());
+    int d = SimPlanner::table_depth<T>(depth);
+    for( size_t k = 0; k < feature_atoms.size(); ++k ) {
+        assert(feature_atoms[k] < int(novelty_table.size()));
+        if( novelty_table.depth(feature_atoms[k]) > d )
+            return feature_atoms[k];
+    }
+    for( size_t k = 0; k < feature_atoms.size(); ++k ) {
+        if( novelty_table.depth(feature_atoms[k]) == d )
+            return feature_atoms[k];
+    }
+    assert(novelty_table.depth(feature_atoms[0]) < d);
+    return feature_atoms[0];
+}
+
+// novelty check and update on atoms of corpus, with table entries of type T;
+// the fused kernel is checked against the reference two-pass kernels
+template<typename T>
+static void bench_novelty(const KernelPlanner &planner, int features, const vector<vector<int> > &atoms, size_t reps) {
+    Timer update_timer, check_timer, fused_timer;
+    size_t novel = 0, fused_novel = 0;
+    for( size_t r = 0; r < reps; ++r ) {
+        NoveltyTable<T> novelty_table(planner.num_tracked_atoms_);
+        for( size_t k = 0; k < atoms.size(); ++k ) {
+            size_t depth = k % 50;
+            check_timer.start();
+            int atom = get_novel_atom(depth, atoms[k], novelty_table);
+            check_timer.stop();
+            novel += novelty_table.depth(atom) > int(depth);
+            update_timer.start();
+            update_novelty_table(depth, atoms[k], novelty_table);
+            update_timer.stop();
+        }
+
+        NoveltyTable<T> fused_novelty_table(planner.num_tracked_atoms_);
+        for( size_t k = 0; k < atoms.size(); ++k ) {
+            size_t depth = k % 50, num_updated = 0;
+            fused_timer.start();
+            int novelty = planner.check_and_update_novelty(depth, atoms[k], fused_novelty_table, true, num_updated);
+            fused_timer.stop();
+            fused_novel += novelty > int(depth);
+        }
+    }
+    report("get_novel_atom(" + to_string(features) + ")", reps * atoms.size(), check_timer.elapsed_);
+    report("update_novelty_table(" + to_string(features) + ")", reps * atoms.size(), update_timer.elapsed_);
+    report("check_and_update_novelty(" + to_string(features) + ")", reps * atoms.size(), fused_timer.elapsed_);
+    assert(fused_novel == novel);
+    cout << "bench-kernels: features=" << features << " novel=" << double(novel) / (reps * atoms.size()) << endl;
+}
+
+// frontier entry for breadth-first search (see BfsIW)
+struct frontier_entry_t {
+    int depth_;
+    float path_reward_;
+    frontier_entry_t(int depth, float path_reward) : depth_(depth), path_reward_(path_reward) { }
+    int depth() const {
+        return depth_;
+    }
+    float path_reward() const {
+        return path_reward_;
+    }
+};
+struct frontier_entry_comparator_t {
+    bool break_ties_using_rewards_;
+    frontier_entry_comparator_t(bool break_ties_using_rewards) : break_ties_using_rewards_(break_ties_using_rewards) { }
+    bool operator()(const frontier_entry_t &lhs, const frontier_entry_t &rhs) const {
+        return
+          (lhs.depth() > rhs.depth()) ||
+          (break_ties_using_rewards_ && (lhs.depth() == rhs.depth()) && (lhs.path_reward() < rhs.path_reward()));
+    }
+};
+
+typedef std::priority_queue<frontier_entry_t, vector<frontier_entry_t>, frontier_entry_comparator_t> frontier_heap_t;
+
+static frontier_entry_t pop_entry(frontier_heap_t &q) {
+    frontier_entry_t entry = q.top();
+    q.pop();
+    return entry;
+}
+static frontier_entry_t pop_entry(Frontier<frontier_entry_t> &q) {
+    return q.pop();
+}
+
+// breadth-first search with given branching over given number of nodes,
+// where a quarter of popped nodes are expanded (push and pop per node)
+template<typename Q>
+static size_t run_frontier(Q &q, size_t branching, size_t num_nodes, Random::Engine &rng, Timer &timer) {
+    size_t n = 1;
+    timer.start();
+    q.push(frontier_entry_t(0, 0));
+    while( n < num_nodes ) {
+        frontier_entry_t entry = pop_entry(q);
+        if( (rng.uniform(4) == 0) || q.empty() ) {
+            for( size_t k = 0; k < branching; ++k )
+                q.push(frontier_entry_t(1 + entry.depth(), entry.path_reward() + rng.uniform(2)));
+            n += branching;
+        }
+    }
+    timer.stop();
+    return n;
+}
+
+// build tree breadth-first with given branching until it has at least given number of nodes
+static size_t build_tree(Node *root, const ActionVect &actions, size_t num_nodes, Timer &timer) {
+    vector<Node*> frontier(1, root);
+    size_t n = 1;
+    for( size_t k = 0; n < num_nodes; ++k ) {
+        Node *node = frontier[k];
+        timer.start();
+        node->expand(actions);
+        for( size_t j = 0; j < actions.size(); ++j )
+            frontier.push_back(node->materialize(actions[j]));
+        timer.stop();
+        node->is_info_valid_ = 1;
+        n += actions.size();
+    }
+    return n;
+}
+
+int main(int argc, char **argv) {
+    string opt_corpus;
+    size_t opt_states = 1000;
+    size_t opt_reps = 5;
+    size_t opt_tree_nodes = 100000;
+    int opt_frameskip = 15;
+    int opt_seed = 0;
+    string opt_rom;
+    for( int k = 1; k < argc; ++k ) {
+        string arg = argv[k];
+        if( (arg == "--corpus") && (k + 1 < argc) ) {
+            opt_corpus = argv[++k];
+        } else if( (arg == "--states") && (k + 1 < argc) ) {
+            opt_states = atol(argv[++k]);
+        } else if( (arg == "--reps") && (k + 1 < argc) ) {
+            opt_reps = atol(argv[++k]);
+        } else if( (arg == "--tree-nodes") && (k + 1 < argc) ) {
+            opt_tree_nodes = atol(argv[++k]);
+        } else if( (arg == "--frameskip") && (k + 1 < argc) ) {
+            opt_frameskip = atoi(argv[++k]);
+        } else if( (arg == "--seed") && (k + 1 < argc) ) {
+            opt_seed = atoi(argv[++k]);
+        } else if( (arg[0] != '-') && opt_rom.empty() ) {
+            opt_rom = arg;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--corpus <file>] [--states <n>] [--reps <n>] [--tree-nodes <n>] [--frameskip <n>] [--seed <n>] <rom>" << endl;
+            return -1;
+        }
+    }
+    if( opt_rom.empty() ) {
+        cerr << "Usage: " << argv[0] << " [--corpus <file>] [--states <n>] [--reps <n>] [--tree-nodes <n>] [--frameskip <n>] [--seed <n>] <rom>" << endl;
+        return -1;
+    }
+
+    Logger::set_mode(Logger::Warning);
+    Logger::set_output_stream(cerr);
+
+    ALEInterface sim(ale::Logger::Silent);
+    sim.setInt("frame_skip", opt_frameskip);
+    sim.setInt("random_seed", opt_seed);
+    sim.setFloat("repeat_action_probability", 0.00);
+    sim.loadROM(opt_rom);
+
+    Random::Engine rng(opt_seed);
+    MyALEScreen::create_background_image();
+    MyALEScreen::compute_background_image(sim, 100, rng);
+
+    // corpus
+    vector<sample_t> corpus;
+    if( !opt_corpus.empty() && load_corpus(opt_corpus, corpus) ) {
+        cout << "bench-kernels: corpus loaded from '" << opt_corpus << "' (#states=" << corpus.size() << ")" << endl;
+    } else {
+        record_corpus(sim, opt_states, rng, corpus);
+        cout << "bench-kernels: corpus recorded (#states=" << corpus.size() << ")" << endl;
+        if( !opt_corpus.empty() && !save_corpus(opt_corpus, corpus) )
+            cerr << "error: cannot save corpus to '" << opt_corpus << "'" << endl;
+    }
+    if( corpus.empty() ) return 0;
+
+    vector<ALEState> states;
+    vector<ALEScreen> screens;
+    for( size_t k = 0; k < corpus.size(); ++k ) {
+        states.push_back(ALEState(corpus[k].state_));
+        screens.push_back(ALEScreen(MyALEScreen::height_, MyALEScreen::width_));
+        memcpy(screens.back().getArray(), &corpus[k].screen_[0], corpus[k].screen_.size());
+    }
+    cout << "bench-kernels: rom=" << opt_rom << " frameskip=" << opt_frameskip << " seed=" << opt_seed << " reps=" << opt_reps << endl;
+
+    // cloneState and restoreState
+    {
+        Timer clone_timer, restore_timer;
+        ALEState state;
+        for( size_t r = 0; r < opt_reps; ++r ) {
+            for( size_t k = 0; k < states.size(); ++k ) {
+                restore_timer.start();
+                sim.restoreState(states[k]);
+                restore_timer.stop();
+                clone_timer.start();
+                state = sim.cloneState();
+                clone_timer.stop();
+            }
+        }
+        report("restoreState", opt_reps * states.size(), restore_timer.elapsed_);
+        report("cloneState", opt_reps * states.size(), clone_timer.elapsed_);
+    }
+
+    // features and novelty tables for each feature type
+    for( int features = 0; features <= 4; ++features ) {
+        vector<vector<int> > atoms(corpus.size());
+        if( features == 0 ) {
+            for( size_t k = 0; k < corpus.size(); ++k ) {
+                for( size_t i = 0; i < 128; ++i )
+                    atoms[k].push_back((i << 8) + corpus[k].ram_[i]);
+            }
+        } else if( features == 4 ) {
+            Timer timer;
+            for( size_t r = 0; r < opt_reps; ++r ) {
+                for( size_t k = 0; k < corpus.size(); ++k ) {
+                    atoms[k].clear();
+                    timer.start();
+                    Features::RamBits::compute_atoms(&corpus[k].ram_[0], atoms[k]);
+                    timer.stop();
+                }
+            }
+            report("compute_features(4)", opt_reps * corpus.size(), timer.elapsed_);
+        } else {
+            Timer timer;
+            for( size_t r = 0; r < opt_reps; ++r ) {
+                for( size_t k = 0; k < corpus.size(); ++k ) {
+                    atoms[k].clear();
+                    const vector<int> *prev_atoms = (features == 3) && (k > 0) ? &atoms[k - 1] : nullptr;
+                    timer.start();
+                    MyALEScreen screen(screens[k], features, &atoms[k], prev_atoms);
+                    timer.stop();
+                }
+            }
+            report("compute_features(" + to_string(features) + ")", opt_reps * corpus.size(), timer.elapsed_);
+        }
+
+        size_t num_atoms = 0;
+        for( size_t k = 0; k < atoms.size(); ++k )
+            num_atoms += atoms[k].size();
+        cout << "bench-kernels: features=" << features << " avg-atoms/state=" << double(num_atoms) / atoms.size() << endl;
+
+        // encoding and decoding of atom sets stored on nodes
+        {
+            Timer encode_timer, decode_timer;
+            vector<AtomSet> atom_sets(atoms.size());
+            vector<int> scratch;
+            size_t num_bytes = 0;
+            for( size_t r = 0; r < opt_reps; ++r ) {
+                num_bytes = 0;
+                for( size_t k = 0; k < atoms.size(); ++k ) {
+                    scratch = atoms[k];
+                    encode_timer.start();
+                    atom_sets[k].assign(scratch);
+                    encode_timer.stop();
+                    num_bytes += atom_sets[k].bytes();
+                    decode_timer.start();
+                    atom_sets[k].decode(scratch);
+                    decode_timer.stop();
+                    assert(scratch.size() == atoms[k].size());
+                }
+            }
+            report("encode_atoms(" + to_string(features) + ")", opt_reps * atoms.size(), encode_timer.elapsed_);
+            report("decode_atoms(" + to_string(features) + ")", opt_reps * atoms.size(), decode_timer.elapsed_);
+            cout << "bench-kernels: features=" << features << " bytes/atom=" << (num_atoms == 0 ? 0 : double(num_bytes) / num_atoms) << endl;
+        }
+
+        KernelPlanner planner(sim, opt_frameskip, num_tracked_atoms(features));
+        bench_novelty<uint16_t>(planner, features, atoms, opt_reps);
+    }
+
+    // tree kernels
+    {
+        ActionVect actions = sim.getMinimalActionSet();
+        Timer expand_timer, backup_timer, remove_timer;
+        size_t num_nodes = 0;
+        for( size_t r = 0; r < opt_reps; ++r ) {
+            Node *root = new Node(nullptr, PLAYER_A_NOOP, 0);
+            num_nodes += build_tree(root, actions, opt_tree_nodes, expand_timer);
+
+            vector<Node*> stack(1, root);
+            while( !stack.empty() ) {
+                Node *node = stack.back();
+                stack.pop_back();
+                node->reward_ = rng.uniform(4) == 0 ? float(rng.uniform(10)) : 0;
+                for( Node *child = node->first_child_; child != nullptr; child = child->sibling_ )
+                    stack.push_back(child);
+            }
+
+            backup_timer.start();
+            root->backup_values(0.995);
+            backup_timer.stop();
+
+            remove_timer.start();
+            remove_tree(root);
+            remove_timer.stop();
+        }
+        report("Node::expand (per node)", num_nodes, expand_timer.elapsed_);
+        report("backup_values (per node)", num_nodes, backup_timer.elapsed_);
+        report("remove_tree (per node)", num_nodes, remove_timer.elapsed_);
+
+        // BFS frontier: priority queue vs depth buckets
+        for( int break_ties = 0; break_ties < 2; ++break_ties ) {
+            Timer heap_timer, buckets_timer;
+            size_t num_heap_nodes = 0, num_bucket_nodes = 0;
+            for( size_t r = 0; r < opt_reps; ++r ) {
+                frontier_heap_t heap((frontier_entry_comparator_t(break_ties)));
+                Random::Engine heap_rng(opt_seed + r);
+                num_heap_nodes += run_frontier(heap, actions.size(), opt_tree_nodes, heap_rng, heap_timer);
+                Frontier<frontier_entry_t> buckets(break_ties);
+                Random::Engine buckets_rng(opt_seed + r);
+                num_bucket_nodes += run_frontier(buckets, actions.size(), opt_tree_nodes, buckets_rng, buckets_timer);
+            }
+            report("priority_queue(break-ties=" + to_string(break_ties) + ") (per node)", num_heap_nodes, heap_timer.elapsed_);
+            report("Frontier(break-ties=" + to_string(break_ties) + ") (per node)", num_bucket_nodes, buckets_timer.elapsed_);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+// (c) 2017 Blai Bonet
+
+// Microbenchmark for disabled log messages in hot loops. Compares messages
+// written directly through Logger (arguments always evaluated) with messages
+// written through the LOGGER() macro (arguments evaluated only if emitted).
+// Build with LOGGER_MIN_MODE=1 to measure messages removed at compile time.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "logger.h"
+
+using namespace std;
+
+static size_t g_evaluations = 0;
+
+// stands for typical message arguments such as std::to_string(root->num_nodes())
+static string argument(size_t k) {
+    ++g_evaluations;
+    return to_string(double(k) * 0.5);
+}
+
+template<typename F>
+double time_per_op(F f, size_t n) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for( size_t k = 0; k < n; ++k )
+        f(k);
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    return double(chrono::duration_cast<chrono::nanoseconds>(end - start).count()) / n;
+}
+
+struct Eager {
+    void operator()(size_t k) const {
+        Logger::Continuation(Logger::Debug) << k << "@" << argument(k) << flush;
+    }
+};
+
+struct Lazy {
+    void operator()(size_t k) const {
+        LOGGER(Logger::Continuation(Logger::Debug)) << k << "@" << argument(k) << flush;
+    }
+};
+
+struct Baseline {
+    void operator()(size_t k) const {
+        asm volatile("" : : "r"(k) : "memory");
+    }
+};
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? atol(argv[1]) : 10000000;
+    ostream null_stream(nullptr);
+    Logger::set_output_stream(null_stream);
+    Logger::set_mode(Logger::Info); // debug messages are disabled at runtime
+
+    cout << "bench-logger: LOGGER_MIN_MODE=" << LOGGER_MIN_MODE << " n=" << n << endl;
+
+    g_evaluations = 0;
+    double baseline = time_per_op(Baseline(), n);
+    cout << "  empty loop:          " << baseline << " ns/op" << endl;
+
+    g_evaluations = 0;
+    double eager = time_per_op(Eager(), n);
+    cout << "  Logger (disabled):   " << eager << " ns/op, #evaluations=" << g_evaluations << endl;
+
+    g_evaluations = 0;
+    double lazy = time_per_op(Lazy(), n);
+    cout << "  LOGGER() (disabled): " << lazy << " ns/op, #evaluations=" << g_evaluations << endl;
+
+    return 0;
+}
+
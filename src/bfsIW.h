@@ -4,17 +4,41 @@
 #define BFS_IW_H
 
 #include <cassert>
-#include <map>
-#include <queue>
-#include <set>
 #include <string>
 #include <vector>
 
+#include "frontier.h"
 #include "sim_planner.h"
 #include "logger.h"
+#include "profiler.h"
 
+// F is the feature-mode policy (see features.h)
+template<typename F>
 struct BfsIW : SimPlanner {
-    const int screen_features_;
+    typedef NoveltyTables<typename F::depth_t> novelty_tables_t;
+
+    // queue entries are nodes or pending children (given by parent and
+    // action), which are materialized when popped. For a persistent
+    // frontier, branch_depth_ is the depth of the deepest node of the
+    // selected branch that is an ancestor of the entry (see mark_frontier)
+    struct QueueEntry {
+        Node *node_;
+        Node *parent_;
+        Action action_;
+        int branch_depth_;
+        QueueEntry(Node *node) : node_(node), parent_(nullptr), action_(PLAYER_A_NOOP), branch_depth_(0) { }
+        QueueEntry(Node *parent, Action action) : node_(nullptr), parent_(parent), action_(action), branch_depth_(0) { }
+        int depth() const {
+            return node_ != nullptr ? node_->depth_ : 1 + parent_->depth_;
+        }
+        float path_reward() const {
+            return node_ != nullptr ? node_->path_reward_ : 0;
+        }
+    };
+
+    // breadth-first search with ties broken in favor of bigger path reward
+    typedef Frontier<QueueEntry> queue_t;
+
     const float time_budget_;
     const bool novelty_subtables_;
     const bool random_actions_;
@@ -24,30 +48,52 @@ struct BfsIW : SimPlanner {
     const bool use_alpha_to_update_reward_for_death_;
     const int nodes_threshold_;
     const bool break_ties_using_rewards_;
+    const bool persistent_frontier_;
+
+    // frontier kept across decisions, along with the tip nodes that were
+    // popped and pruned (they are checked again at next decision, as tip
+    // nodes of a rebuilt frontier are), and the size of the prefix and of
+    // the branch at the end of last decision
+    mutable queue_t frontier_;
+    mutable std::vector<QueueEntry> pruned_;
+    mutable size_t frontier_prefix_size_;
+    mutable size_t frontier_branch_size_;
 
     mutable size_t num_expansions_;
     mutable float total_time_;
     mutable float expand_time_;
     mutable size_t root_height_;
     mutable bool random_decision_;
+    mutable size_t frontier_kept_;
+    mutable size_t frontier_dropped_;
+    mutable bool frontier_rebuilt_;
 
     BfsIW(ALEInterface &sim,
           size_t frameskip,
           bool use_minimal_action_set,
-          size_t num_tracked_atoms,
-          int screen_features,
           float simulator_budget,
           float time_budget,
+          size_t memory_budget,
           bool novelty_subtables,
+          size_t sketch_width,
+          size_t sketch_rows,
+          bool sketch_verify,
+          size_t feature_cache_size,
+          bool transpositions,
+          size_t transition_cache_size,
+          bool transition_cache_states,
+          bool action_equivalence,
+          bool warm_start_novelty,
+          bool warm_start_verify,
           bool random_actions,
           size_t max_rep,
           float discount,
           float alpha,
           bool use_alpha_to_update_reward_for_death,
           int nodes_threshold,
-          bool break_ties_using_rewards)
-      : SimPlanner(sim, frameskip, use_minimal_action_set, simulator_budget, num_tracked_atoms),
-        screen_features_(screen_features),
+          bool break_ties_using_rewards,
+          bool persistent_frontier)
+      : SimPlanner(sim, frameskip, use_minimal_action_set, simulator_budget, F::num_atoms_, memory_budget, sketch_width, sketch_rows, sketch_verify, feature_cache_size, transpositions, transition_cache_size, transition_cache_states, action_equivalence, warm_start_novelty, warm_start_verify),
         time_budget_(time_budget),
         novelty_subtables_(novelty_subtables),
         random_actions_(random_actions),
@@ -56,7 +102,11 @@ struct BfsIW : SimPlanner {
         alpha_(alpha),
         use_alpha_to_update_reward_for_death_(use_alpha_to_update_reward_for_death),
         nodes_threshold_(nodes_threshold),
-        break_ties_using_rewards_(break_ties_using_rewards) {
+        break_ties_using_rewards_(break_ties_using_rewards),
+        persistent_frontier_(persistent_frontier),
+        frontier_(break_ties_using_rewards),
+        frontier_prefix_size_(0),
+        frontier_branch_size_(0) {
     }
     virtual ~BfsIW() { }
 
@@ -64,10 +114,17 @@ struct BfsIW : SimPlanner {
         return std::string("bfs(")
           + "frameskip=" + std::to_string(frameskip_)
           + ",minimal-action-set=" + std::to_string(use_minimal_action_set_)
-          + ",features=" + std::to_string(screen_features_)
+          + ",features=" + std::to_string(F::type_)
           + ",simulator-budget=" + std::to_string(simulator_budget_)
           + ",time-budget=" + std::to_string(time_budget_)
+          + ",memory-budget=" + std::to_string(memory_budget_)
           + ",novelty-subtables=" + std::to_string(novelty_subtables_)
+          + ",novelty-sketch=" + std::to_string(sketch_.rows()) + "x" + std::to_string(sketch_.width())
+          + ",feature-cache=" + std::to_string(feature_cache_.capacity())
+          + ",transpositions=" + std::to_string(use_transpositions_)
+          + ",transition-cache=" + std::to_string(transition_cache_.capacity())
+          + ",action-equivalence=" + std::to_string(use_action_equivalence_)
+          + ",warm-start-novelty=" + std::to_string(use_warm_start_novelty_)
           + ",random-actions=" + std::to_string(random_actions_)
           + ",max-rep=" + std::to_string(max_rep_)
           + ",discount=" + std::to_string(discount_)
@@ -75,6 +132,7 @@ struct BfsIW : SimPlanner {
           + ",use-alpha-to-update-reward-for-death=" + std::to_string(use_alpha_to_update_reward_for_death_)
           + ",nodes-threshold=" + std::to_string(nodes_threshold_)
           + ",break-ties-using-rewards=" + std::to_string(break_ties_using_rewards_)
+          + ",persistent-frontier=" + std::to_string(persistent_frontier_)
           + ")";
     }
 
@@ -99,22 +157,28 @@ struct BfsIW : SimPlanner {
         Logger::Info << "prefix: sz=" << prefix.size() << ", actions=";
         print_prefix(Logger::Info, prefix);
         Logger::Continuation(Logger::Info) << std::endl;
-        Logger::Info << "input:"
-                     << " #nodes=" << (root == nullptr ? "na" : std::to_string(root->num_nodes()))
-                     << ", #tips=" << (root == nullptr ? "na" : std::to_string(root->num_tip_nodes()))
-                     << ", height=" << (root == nullptr ? "na" : std::to_string(root->height_))
-                     << std::endl;
+        LOGGER(Logger::Info) << "input:"
+                             << " #nodes=" << (root == nullptr ? "na" : std::to_string(root->num_nodes()))
+                             << ", #tips=" << (root == nullptr ? "na" : std::to_string(root->num_tip_nodes()))
+                             << ", height=" << (root == nullptr ? "na" : std::to_string(root->height_))
+                             << std::endl;
 
         // reset stats and start timer
         reset_stats();
         float start_time = Utils::read_time_in_seconds();
+        Profiler::begin_decision();
+        Profiler::Scope decision_scope(Profiler::Decision);
 
-        // novelty table
-        std::map<int, std::vector<int> > novelty_table_map;
+        // novelty table (and cold table to verify warm start)
+        novelty_tables_t novelty_table_map;
+        novelty_tables_t cold_table_map;
+        reset_novelty_sketch();
 
         // construct root node
         assert((root == nullptr) || (root->action_ == prefix.back()));
         if( root == nullptr ) {
+            frontier_.clear();
+            pruned_.clear();
             Node *root_parent = new Node(nullptr, PLAYER_A_NOOP, -1);
             root_parent->state_ = new ALEState;
             apply_prefix(sim_, initial_sim_state_, prefix, root_parent->state_);
@@ -124,24 +188,22 @@ struct BfsIW : SimPlanner {
         root->parent_->parent_ = nullptr;
 
         // if root has some children, make sure it has all children
+        std::vector<Action> completed;
         if( root->num_children_ > 0 ) {
-            assert(root->first_child_ != nullptr);
-            std::set<Action> root_actions;
-            for( Node *child = root->first_child_; child != nullptr; child = child->sibling_ )
-                root_actions.insert(child->action_);
-
             // complete children
             assert(root->num_children_ <= int(action_set_.size()));
             if( root->num_children_ < int(action_set_.size()) ) {
                 for( size_t k = 0; k < action_set_.size(); ++k ) {
-                    if( root_actions.find(action_set_[k]) == root_actions.end() )
+                    if( !root->has_child(action_set_[k]) ) {
                         root->expand(action_set_[k]);
+                        completed.push_back(action_set_[k]);
+                    }
                 }
             }
-            assert(root->num_children_ == int(action_set_.size()));
+            assert(root->num_children_ <= int(action_set_.size()));
         } else {
             // make sure this root node isn't marked as frame rep
-            root->parent_->feature_atoms_.clear();
+            root->parent_->clear_feature_atoms();
         }
 
         // normalize depths and recompute path rewards
@@ -149,51 +211,66 @@ struct BfsIW : SimPlanner {
         root->normalize_depth();
         root->reset_frame_rep_counters(frameskip_);
         root->recompute_path_rewards(root);
+        reset_transpositions(root);
+        reset_deferred_states(root);
+        account_memory(root->parent_);
+
+        // novelty tables hold atoms of the expanded nodes of the kept tree
+        // (tip nodes are checked again when popped from the frontier)
+        warm_start_novelty<F>(root, novelty_table_map, novelty_subtables_, 0, std::numeric_limits<int>::max(), true);
+
+        // frontier: last one re-rooted at root, or tip nodes of tree
+        prepare_frontier(prefix, root, completed);
+        Logger::Info << "queue: sz=" << frontier_.size() << std::endl;
 
         // construct/extend lookahead tree
         if( int(root->num_nodes()) < nodes_threshold_ ) {
-            bfs(prefix, root, novelty_table_map);
+            Profiler::Scope search_scope(Profiler::Search);
+            bfs(prefix, root, novelty_table_map, warm_start_verify_ ? &cold_table_map : nullptr);
         }
 
         // if nothing was expanded, return random actions (it can only happen with small time budget)
         if( root->num_children_ == 0 ) {
             assert(root->first_child_ == nullptr);
-            assert(time_budget_ != std::numeric_limits<float>::infinity());
+            assert((time_budget_ != std::numeric_limits<float>::infinity()) || memory_budget_hit_);
             random_decision_ = true;
             branch.push_back(random_action());
         } else {
-            assert(root->first_child_ != nullptr);
-
             // backup values and calculate heights
+            Profiler::Scope backup_scope(Profiler::Backup);
             root->backup_values(discount_);
             root->calculate_height();
             root_height_ = root->height_;
+            backup_scope.stop();
 
             // print info about root node
-            Logger::Debug << Logger::green()
-                          << "root:"
-                          << " value=" << root->value_
-                          << ", imm-reward=" << root->reward_
-                          << ", children=[";
+            LOGGER(Logger::Debug) << Logger::green()
+                                  << "root:"
+                                  << " value=" << root->value_
+                                  << ", imm-reward=" << root->reward_
+                                  << ", children=[";
             for( Node *child = root->first_child_; child != nullptr; child = child->sibling_ )
-                Logger::Continuation(Logger::Debug) << child->value_ << ":" << child->action_ << " ";
-            Logger::Continuation(Logger::Debug) << "]" << Logger::normal() << std::endl;
+                LOGGER(Logger::Continuation(Logger::Debug)) << child->value_ << ":" << child->action_ << " ";
+            LOGGER(Logger::Continuation(Logger::Debug)) << "]" << Logger::normal() << std::endl;
 
             // compute branch
+            Profiler::Scope branch_scope(Profiler::BranchSelection);
             if( root->value_ != 0 ) {
-                root->best_branch(branch, discount_);
+                root->best_branch(branch, discount_, rng_);
             } else {
                 if( random_actions_ ) {
                     random_decision_ = true;
                     branch.push_back(random_zero_value_action(root, discount_));
                 } else {
-                    root->longest_zero_value_branch(discount_, branch);
+                    root->longest_zero_value_branch(discount_, branch, rng_);
                     assert(!branch.empty());
                 }
             }
 
             // make sure states along branch exist (only needed when doing partial caching)
-            generate_states_along_branch(root, branch, screen_features_, alpha_, use_alpha_to_update_reward_for_death_);
+            generate_states_along_branch<F>(root, branch, alpha_, use_alpha_to_update_reward_for_death_);
+            branch_scope.stop();
+            mark_frontier(root, branch);
 
             // print branch
             assert(!branch.empty());
@@ -205,104 +282,204 @@ struct BfsIW : SimPlanner {
             //root->print_branch(logos_, branch);
         }
 
+        // keep frontier for next decision
+        if( persistent_frontier_ ) {
+            frontier_prefix_size_ = prefix.size();
+            frontier_branch_size_ = branch.size();
+        } else {
+            frontier_.clear();
+            pruned_.clear();
+        }
+
         // stop timer and print stats
+        decision_scope.stop();
         total_time_ = Utils::read_time_in_seconds() - start_time;
         print_stats(Logger::Stats, *root, novelty_table_map);
+        record_stats(*root, novelty_table_map);
 
         // return root node
         return root;
     }
 
-    // breadth-first search with ties broken in favor of bigger path reward
-    struct NodeComparator {
-        bool break_ties_using_rewards_;
-        NodeComparator(bool break_ties_using_rewards) : break_ties_using_rewards_(break_ties_using_rewards) {
-        }
-        bool operator()(const Node *lhs, const Node *rhs) const {
-            return
-              (lhs->depth_ > rhs->depth_) ||
-              (break_ties_using_rewards_ && (lhs->depth_ == rhs->depth_) && (lhs->path_reward_ < rhs->path_reward_));
-        }
-    };
-
-    void bfs(const std::vector<Action> &prefix, Node *root, std::map<int, std::vector<int> > &novelty_table_map) const {
-        // priority queue
-        NodeComparator cmp(break_ties_using_rewards_);
-        std::priority_queue<Node*, std::vector<Node*>, NodeComparator> q(cmp);
-
-        // add tip nodes to queue
-        add_tip_nodes_to_queue(root, q);
-        Logger::Info << "queue: sz=" << q.size() << std::endl;
+    void bfs(const std::vector<Action> &prefix, Node *root, novelty_tables_t &novelty_table_map, novelty_tables_t *cold_table_map) const {
+        queue_t &q = frontier_;
 
         // explore in breadth-first manner
         float start_time = Utils::read_time_in_seconds();
-        while( !q.empty() && (int(simulator_calls_) < simulator_budget_) && (Utils::read_time_in_seconds() - start_time < time_budget_) ) {
-            Node *node = q.top();
-            q.pop();
+        while( !q.empty() && (int(simulator_calls_) < simulator_budget_) && (Utils::read_time_in_seconds() - start_time < time_budget_) && !memory_budget_exhausted() ) {
+            QueueEntry entry = q.pop();
+            Node *node = entry_node(entry);
+            if( node == nullptr ) continue;
 
             // print debug info
-            Logger::Continuation(Logger::Debug) << node->depth_ << "@" << node->path_reward_ << std::flush;
+            LOGGER(Logger::Continuation(Logger::Debug)) << node->depth_ << "@" << node->path_reward_ << std::flush;
 
             // update node info
             assert((node->num_children_ == 0) && (node->first_child_ == nullptr));
             assert(node->visited_ || (node->is_info_valid_ != 2));
             if( node->is_info_valid_ != 2 ) {
-                update_info(node, screen_features_, alpha_, use_alpha_to_update_reward_for_death_);
+                update_info<F>(node, alpha_, use_alpha_to_update_reward_for_death_);
                 assert((node->num_children_ == 0) && (node->first_child_ == nullptr));
                 node->visited_ = true;
             }
 
+            // merge node into sibling that reaches same state
+            if( node->equivalent_ ) {
+                LOGGER(Logger::Continuation(Logger::Debug)) << "e" << "," << std::flush;
+                merge_equivalent_child(node);
+                continue;
+            }
+
             // check termination at this node
             if( node->terminal_ ) {
-                Logger::Continuation(Logger::Debug) << "t" << "," << std::flush;
+                LOGGER(Logger::Continuation(Logger::Debug)) << "t" << "," << std::flush;
+                keep_pruned_tip(node);
+                continue;
+            }
+
+            // prune duplicates of nodes in transposition table
+            if( node->duplicate_ ) {
+                LOGGER(Logger::Continuation(Logger::Debug)) << "d" << "," << std::flush;
+                keep_pruned_tip(node);
                 continue;
             }
 
             // verify max repetitions of feature atoms (screen mode)
-            if( node->frame_rep_ > int(max_rep_) ) {
-                Logger::Continuation(Logger::Debug) << "r" << node->frame_rep_ << "," << std::flush;
+            if( F::screen_ && (node->frame_rep_ > int(max_rep_)) ) {
+                LOGGER(Logger::Continuation(Logger::Debug)) << "r" << node->frame_rep_ << "," << std::flush;
+                keep_pruned_tip(node);
                 continue;
             }
 
             // calculate novelty and prune
-            if( node->frame_rep_ == 0 ) {
-                // calculate novelty
-                std::vector<int> &novelty_table = get_novelty_table(node, novelty_table_map, novelty_subtables_);
-                int atom = get_novel_atom(node->depth_, node->feature_atoms_, novelty_table);
-                assert((atom >= 0) && (atom < int(novelty_table.size())));
+            if( !F::screen_ || (node->frame_rep_ == 0) ) {
+                // calculate novelty and update novelty table (nothing
+                // is updated for nodes that are not novel)
+                size_t num_updated = 0;
+                int novelty = check_and_update_novelty<F>(node, novelty_table_map, novelty_subtables_, true, num_updated);
+                if( cold_table_map != nullptr )
+                    check_warm_start_prune<F>(node, novelty, *cold_table_map, novelty_subtables_);
 
                 // prune node using novelty
-                if( novelty_table[atom] <= node->depth_ ) {
-                    Logger::Continuation(Logger::Debug) << "p" << "," << std::flush;
+                if( novelty <= node->depth_ ) {
+                    LOGGER(Logger::Continuation(Logger::Debug)) << "p" << "," << std::flush;
+                    keep_pruned_tip(node);
                     continue;
                 }
-
-                // update novelty table
-                update_novelty_table(node->depth_, node->feature_atoms_, novelty_table);
             }
-            Logger::Continuation(Logger::Debug) << "+" << std::flush;
+            LOGGER(Logger::Continuation(Logger::Debug)) << "+" << std::flush;
 
             // expand node
-            if( node->frame_rep_ == 0 ) {
+            if( !F::screen_ || (node->frame_rep_ == 0) ) {
                 ++num_expansions_;
+                Profiler::Scope scope(Profiler::Expand);
                 float start_time = Utils::read_time_in_seconds();
                 node->expand(action_set_, false);
                 expand_time_ += Utils::read_time_in_seconds() - start_time;
             } else {
-                assert((node->parent_ != nullptr) && (screen_features_ > 0));
+                assert((node->parent_ != nullptr) && F::screen_);
                 node->expand(node->action_);
             }
-            assert((node->num_children_ > 0) && (node->first_child_ != nullptr));
-            Logger::Continuation(Logger::Debug) << node->num_children_ << "," << std::flush;
+            assert((node->num_children_ > 0) && (node->first_child_ == nullptr));
+            if( !use_warm_start_novelty_ ) trim_atoms<F>(node);
+            LOGGER(Logger::Continuation(Logger::Debug)) << node->num_children_ << "," << std::flush;
 
-            // add children to queue
-            for( Node *child = node->first_child_; child != nullptr; child = child->sibling_ )
-                q.push(child);
+            // add (pending) children to queue
+            push_pending_children(node, q);
         }
-        Logger::Continuation(Logger::Debug) << std::endl;
+        LOGGER(Logger::Continuation(Logger::Debug)) << std::endl;
     }
 
-    void add_tip_nodes_to_queue(Node *node, std::priority_queue<Node*, std::vector<Node*>, NodeComparator> &pq) const {
+    // node for entry; pending children are materialized. A pending child
+    // of a kept frontier may have been materialized along the branch of
+    // last decision, and is then returned if not visited
+    Node* entry_node(const QueueEntry &entry) const {
+        if( entry.node_ != nullptr ) return entry.node_;
+        if( (entry.parent_->pending_actions_ & Node::action_bit(entry.action_)) != 0 )
+            return materialize_child(entry.parent_, entry.action_);
+        Node *node = entry.parent_->child(entry.action_);
+        return (node == nullptr) || node->visited_ ? nullptr : node;
+    }
+
+    // popped tip node that isn't expanded (kept for next decision)
+    void keep_pruned_tip(Node *node) const {
+        if( persistent_frontier_ ) pruned_.push_back(QueueEntry(node));
+    }
+
+    // set up frontier for root. When the tree of last decision was kept,
+    // its frontier is re-rooted by dropping the entries that aren't below
+    // root (only their branch depths are inspected since their nodes may
+    // have been deleted when advancing the tree), and the pruned tip nodes
+    // below root and the children added to root are pushed, so the frontier
+    // holds the tip nodes of the tree. Otherwise, or if nothing is left,
+    // the frontier is made of the tip nodes of the tree by traversal
+    void prepare_frontier(const std::vector<Action> &prefix, Node *root, const std::vector<Action> &completed) const {
+        size_t executed = prefix.size() - frontier_prefix_size_;
+        if( persistent_frontier_ && (!frontier_.empty() || !pruned_.empty()) && (prefix.size() > frontier_prefix_size_) && (executed <= frontier_branch_size_) ) {
+            size_t size = frontier_.size() + pruned_.size();
+            BranchDepthAtLeast keep(executed);
+            frontier_.reroot(executed, keep);
+            for( size_t k = 0; k < pruned_.size(); ++k ) {
+                if( keep(pruned_[k]) )
+                    frontier_.push(pruned_[k]);
+            }
+            frontier_kept_ = frontier_.size();
+            frontier_dropped_ = size - frontier_kept_;
+            for( size_t k = 0; k < completed.size(); ++k )
+                frontier_.push(QueueEntry(root, completed[k]));
+        }
+        pruned_.clear();
+        if( frontier_.empty() ) {
+            frontier_.clear();
+            add_tip_nodes_to_queue(root, frontier_);
+            frontier_rebuilt_ = true;
+        }
+    }
+
+    struct BranchDepthAtLeast {
+        const int depth_;
+        BranchDepthAtLeast(int depth) : depth_(depth) { }
+        bool operator()(const QueueEntry &entry) const {
+            return entry.branch_depth_ >= depth_;
+        }
+    };
+
+    // set branch depths of frontier entries (and pruned tip nodes) for the
+    // branch to be executed;
+    // after executing k actions, the entries below the new root are those
+    // with branch depth at least k
+    void mark_frontier(Node *root, const std::deque<Action> &branch) const {
+        if( !persistent_frontier_ ) return;
+        BranchMarker marker;
+        marker.path_.push_back(root);
+        for( size_t k = 0; k < branch.size(); ++k ) {
+            marker.path_.push_back(marker.path_.back()->child(branch[k]));
+            assert(marker.path_.back() != nullptr);
+        }
+        frontier_.visit(marker);
+        for( size_t k = 0; k < pruned_.size(); ++k )
+            marker(pruned_[k]);
+    }
+
+    struct BranchMarker {
+        std::vector<const Node*> path_;      // nodes along branch (path_[d] has depth d)
+        void operator()(QueueEntry &entry) const {
+            const Node *node = entry.node_ != nullptr ? entry.node_ : entry.parent_;
+            while( node->depth_ >= int(path_.size()) )
+                node = node->parent_;
+            while( node != path_[node->depth_] )
+                node = node->parent_;
+            entry.branch_depth_ = node->depth_;
+        }
+    };
+
+    // children are queued in decreasing order of actions
+    void push_pending_children(Node *node, queue_t &q) const {
+        for( size_t k = node->num_pending_children(); k > 0; --k )
+            q.push(QueueEntry(node, node->pending_action(k - 1)));
+    }
+
+    void add_tip_nodes_to_queue(Node *node, queue_t &pq) const {
         std::deque<Node*> q;
         q.push_back(node);
         while( !q.empty() ) {
@@ -310,9 +487,9 @@ struct BfsIW : SimPlanner {
             q.pop_front();
             if( n->num_children_ == 0 ) {
                 assert(n->first_child_ == nullptr);
-                pq.push(n);
+                pq.push(QueueEntry(n));
             } else {
-                assert(n->first_child_ != nullptr);
+                push_pending_children(n, pq);
                 for( Node *child = n->first_child_; child != nullptr; child = child->sibling_ )
                     q.push_back(child);
             }
@@ -326,14 +503,20 @@ struct BfsIW : SimPlanner {
         expand_time_ = 0;
         root_height_ = 0;
         random_decision_ = false;
+        frontier_kept_ = 0;
+        frontier_dropped_ = 0;
+        frontier_rebuilt_ = false;
     }
 
-    void print_stats(Logger::mode_t logger_mode, const Node &root, const std::map<int, std::vector<int> > &novelty_table_map) const {
+    void print_stats(Logger::mode_t logger_mode, const Node &root, const novelty_tables_t &novelty_table_map) const {
+        if( !Logger::enabled(logger_mode) ) return;
         logger_mode << "decision-stats:"
                     << " #entries=[";
 
-        for( std::map<int, std::vector<int> >::const_iterator it = novelty_table_map.begin(); it != novelty_table_map.end(); ++it )
-            Logger::Continuation(logger_mode) << it->first << ":" << num_entries(it->second) << "/" << it->second.size() << ",";
+        for( size_t k = 0; k < novelty_table_map.indices().size(); ++k ) {
+            const NoveltyTable<typename F::depth_t> &novelty_table = novelty_table_map.at(novelty_table_map.indices()[k]);
+            Logger::Continuation(logger_mode) << novelty_table_map.indices()[k] << ":" << num_entries(novelty_table) << "/" << novelty_table.size() << ",";
+        }
 
         Logger::Continuation(logger_mode)
           << "]"
@@ -355,11 +538,63 @@ struct BfsIW : SimPlanner {
           << " expand-time=" << expand_time_
           << " update-novelty-time=" << update_novelty_time_
           << " get-atoms-calls=" << get_atoms_calls_
+          << " derived-atoms-skipped=" << derived_atoms_skipped_
           << " get-atoms-time=" << get_atoms_time_
-          << " novel-atom-time=" << novel_atom_time_
-          << std::endl;
+          << " novel-atom-time=" << novel_atom_time_;
+        print_sketch_stats(logger_mode);
+        print_feature_cache_stats(logger_mode);
+        print_transposition_stats(logger_mode);
+        print_transition_cache_stats(logger_mode);
+        print_action_equivalence_stats(logger_mode);
+        print_warm_start_stats(logger_mode);
+        print_frontier_stats(logger_mode);
+        print_memory_stats(logger_mode, novelty_table_map);
+    }
+
+    void print_frontier_stats(Logger::mode_t logger_mode) const {
+        if( !persistent_frontier_ ) return;
+        Logger::Continuation(logger_mode)
+          << " frontier=" << frontier_.size()
+          << " frontier-kept=" << frontier_kept_
+          << " frontier-dropped=" << frontier_dropped_
+          << " frontier-rebuilt=" << frontier_rebuilt_;
+    }
+    void add_frontier_stats(StatsSink::Record &record) const {
+        if( !persistent_frontier_ ) return;
+        record.add("frontier", frontier_.size())
+          .add("frontier-kept", frontier_kept_)
+          .add("frontier-dropped", frontier_dropped_)
+          .add("frontier-rebuilt", frontier_rebuilt_);
+    }
+
+    void record_stats(const Node &root, const novelty_tables_t &novelty_table_map) const {
+        if( !StatsSink::available() ) return;
+        std::vector<int> child_heights;
+        for( Node *child = root.first_child_; child != nullptr; child = child->sibling_ )
+            child_heights.push_back(child->height_);
+        StatsSink::Record record("decision");
+        record.add("planner", "bfs");
+        add_novelty_stats(record, novelty_table_map);
+        record.add("nodes", root.num_nodes())
+          .add("tips", root.num_tip_nodes())
+          .add("height", root.height_)
+          .add("child-heights", child_heights)
+          .add("expansions", num_expansions_);
+        add_simulator_stats(record);
+        record.add("total-time", total_time_)
+          .add("expand-time", expand_time_);
+        add_atoms_stats(record);
+        add_sketch_stats(record);
+        add_feature_cache_stats(record);
+        add_transposition_stats(record);
+        add_transition_cache_stats(record);
+        add_action_equivalence_stats(record);
+        add_warm_start_stats(record);
+        add_frontier_stats(record);
+        add_memory_stats(record, novelty_table_map);
+        Profiler::add_stats(record);
+        StatsSink::write(record);
     }
 };
 
 #endif
-
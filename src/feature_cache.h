@@ -0,0 +1,110 @@
+// (c) 2017 Blai Bonet
+
+#ifndef FEATURE_CACHE_H
+#define FEATURE_CACHE_H
+
+#include <cassert>
+#include <list>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "atom_set.h"
+#include "utils.h"
+
+// Bounded LRU cache of screen atoms. Keys are 128-bit hashes of the
+// background-subtracted screen and, for B-PROT, of the fingerprint of the
+// basic atoms of the parent (the only other input of feature computation).
+// Cached atom sets are immutable and shared with the nodes that hit them,
+// along with their fingerprint, so a hit costs a screen hash instead of the
+// computation of the features. The cache is
+// kept across decisions; entries for screens that no longer occur are
+// evicted as least recently used. Heap bytes of cached atom sets are kept
+// up to date on insertion and eviction.
+
+class FeatureCache {
+  public:
+    struct key_t {
+        uint64_t h1_;
+        uint64_t h2_;
+        key_t(uint64_t h1 = 0, uint64_t h2 = 0) : h1_(h1), h2_(h2) { }
+        bool operator==(const key_t &key) const {
+            return (h1_ == key.h1_) && (h2_ == key.h2_);
+        }
+    };
+
+    struct value_t {
+        AtomSet atoms_;
+        uint64_t fingerprint_;
+    };
+
+    FeatureCache(size_t capacity) : capacity_(capacity), bytes_(0) { }
+
+    bool enabled() const {
+        return capacity_ > 0;
+    }
+    size_t capacity() const {
+        return capacity_;
+    }
+    size_t size() const {
+        return entries_.size();
+    }
+    // heap bytes of cached atom sets (shared encodings are also counted
+    // by the nodes that hold them)
+    size_t bytes() const {
+        return bytes_;
+    }
+
+    void clear() {
+        entries_.clear();
+        index_.clear();
+        bytes_ = 0;
+    }
+
+    // cached atoms for key (nullptr if not cached); a hit becomes the most
+    // recently used entry
+    const value_t* find(const key_t &key) {
+        index_t::iterator it = index_.find(key);
+        if( it == index_.end() ) return nullptr;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return &it->second->second;
+    }
+
+    void insert(const key_t &key, const AtomSet &atoms, uint64_t fingerprint) {
+        assert(enabled() && (index_.find(key) == index_.end()));
+        if( entries_.size() == capacity_ ) {
+            bytes_ -= entries_.back().second.atoms_.bytes();
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        entries_.push_front(std::make_pair(key, value_t()));
+        entries_.front().second.atoms_.share(atoms);
+        entries_.front().second.fingerprint_ = fingerprint;
+        index_[key] = entries_.begin();
+        bytes_ += atoms.bytes();
+    }
+
+    // key for screen hash and fingerprint of parent atoms (0 if not used)
+    static key_t key(const key_t &screen_hash, uint64_t parent_fingerprint) {
+        if( parent_fingerprint == 0 ) return screen_hash;
+        return key_t(Utils::mix64(screen_hash.h1_ ^ parent_fingerprint), Utils::mix64(screen_hash.h2_ + parent_fingerprint));
+    }
+
+  private:
+    struct key_hash_t {
+        size_t operator()(const key_t &key) const {
+            return key.h1_;
+        }
+    };
+    typedef std::list<std::pair<key_t, value_t> > list_t;
+    typedef std::unordered_map<key_t, list_t::iterator, key_hash_t> index_t;
+
+    const size_t capacity_;                  // max #entries (0 = disabled)
+    list_t entries_;                         // most recently used first
+    index_t index_;
+    size_t bytes_;
+};
+
+#endif
+
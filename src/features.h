@@ -0,0 +1,138 @@
+// (c) 2017 Blai Bonet
+
+#ifndef FEATURES_H
+#define FEATURES_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <ale_interface.hpp>
+
+#include "profiler.h"
+#include "screen.h"
+
+// Feature-mode policies. Planners are templates on the policy so that the
+// feature type, the size of novelty tables, and whether atoms can repeat
+// along a branch (screen modes) are compile-time constants: mode checks in
+// the search loops fold away and atom extraction is inlined per mode.
+//
+// Each policy provides
+//
+//   type_        value of --features
+//   screen_      true if atoms come from screen (frame repetitions apply)
+//   num_atoms_   number of atoms, i.e. size of novelty tables
+//   depth_t      type of entries in novelty tables
+//   parent_atoms_bound_
+//                compute_derived_atoms() only reads parent atoms below this
+//                bound (0 if parent atoms are not used)
+//   compute_base_atoms(ale, atoms)
+//                atoms that only depend on current ALE state (for screen
+//                modes, the basic atoms)
+//   compute_derived_atoms(ale, atoms, parent_atoms)
+//                atoms determined by base atoms in atoms and parent atoms
+//                (B-PROS and B-PROT), appended to atoms; parent_atoms is
+//                nullptr at root
+//
+// Atoms are computed in two stages so that repeated frames can be detected
+// from base atoms before the expensive derived atoms are computed.
+
+namespace Features {
+
+struct RAM {
+    typedef uint16_t depth_t;
+    static const int type_ = 0;
+    static const bool screen_ = false;
+    static const size_t num_atoms_ = 128 * 256; // 128 8-bit entries
+    static const int parent_atoms_bound_ = 0;
+
+    static void compute_base_atoms(ALEInterface &ale, std::vector<int> &atoms) {
+        Profiler::Scope scope(Profiler::RamAtoms);
+        const ALERAM &ram = ale.getRAM();
+        atoms.resize(128);
+        for( size_t k = 0; k < 128; ++k )
+            atoms[k] = (k << 8) + ram.get(k);
+    }
+    static void compute_derived_atoms(ALEInterface &ale, std::vector<int> &atoms, const std::vector<int> *parent_atoms) {
+    }
+};
+
+struct Basic {
+    typedef uint16_t depth_t;
+    static const int type_ = 1;
+    static const bool screen_ = true;
+    static const size_t num_atoms_ = MyALEScreen::num_basic_features_;
+    static const int parent_atoms_bound_ = 0;
+
+    static void compute_base_atoms(ALEInterface &ale, std::vector<int> &atoms) {
+        MyALEScreen screen(ale, 1, &atoms);
+    }
+    static void compute_derived_atoms(ALEInterface &ale, std::vector<int> &atoms, const std::vector<int> *parent_atoms) {
+    }
+};
+
+struct Bpros {
+    typedef uint16_t depth_t;
+    static const int type_ = 2;
+    static const bool screen_ = true;
+    static const size_t num_atoms_ = MyALEScreen::num_basic_features_ + MyALEScreen::num_bpros_features_;
+    static const int parent_atoms_bound_ = 0;
+
+    static void compute_base_atoms(ALEInterface &ale, std::vector<int> &atoms) {
+        MyALEScreen screen(ale, 1, &atoms);
+    }
+    static void compute_derived_atoms(ALEInterface &ale, std::vector<int> &atoms, const std::vector<int> *parent_atoms) {
+        MyALEScreen::compute_composite_features(type_, atoms, parent_atoms);
+    }
+};
+
+struct Bprot {
+    typedef uint16_t depth_t;
+    static const int type_ = 3;
+    static const bool screen_ = true;
+    static const size_t num_atoms_ = MyALEScreen::num_basic_features_ + MyALEScreen::num_bpros_features_ + MyALEScreen::num_bprot_features_;
+    static const int parent_atoms_bound_ = MyALEScreen::num_basic_features_;
+
+    static void compute_base_atoms(ALEInterface &ale, std::vector<int> &atoms) {
+        MyALEScreen screen(ale, 1, &atoms);
+    }
+    // B-PROT atoms need basic atoms of parent; root only gets basic + B-PROS
+    static void compute_derived_atoms(ALEInterface &ale, std::vector<int> &atoms, const std::vector<int> *parent_atoms) {
+        MyALEScreen::compute_composite_features(type_, atoms, parent_atoms);
+    }
+};
+
+
+// One atom per RAM bit value (128 x 8 bits x 2 values = 2048 atoms): atom
+// 2 * i + v says that bit i of RAM (bit i % 8 of byte i / 8) has value v.
+// Every state has exactly 1024 atoms, one per bit, and a bit that is turned
+// off is as novel as one that is turned on. Atoms are read off the RAM
+// bytes with a branch-free loop (vectorized by the compiler), and are
+// sorted so their encodings take 1 byte per atom. The novelty table has
+// 2048 16-bit entries (4KB) and stays in L1.
+struct RamBits {
+    typedef uint16_t depth_t;
+    static const int type_ = 4;
+    static const bool screen_ = false;
+    static const size_t num_atoms_ = 2 * 128 * 8;
+    static const int parent_atoms_bound_ = 0;
+
+    static void compute_atoms(const byte_t *ram, std::vector<int> &atoms) {
+        atoms.resize(128 * 8);
+        for( size_t k = 0; k < 128; ++k ) {
+            int byte = ram[k];
+            for( size_t b = 0; b < 8; ++b )
+                atoms[8 * k + b] = 2 * int(8 * k + b) + ((byte >> b) & 1);
+        }
+    }
+    static void compute_base_atoms(ALEInterface &ale, std::vector<int> &atoms) {
+        Profiler::Scope scope(Profiler::RamAtoms);
+        compute_atoms(ale.getRAM().array(), atoms);
+    }
+    static void compute_derived_atoms(ALEInterface &ale, std::vector<int> &atoms, const std::vector<int> *parent_atoms) {
+    }
+};
+
+};
+
+#endif
+
@@ -0,0 +1,139 @@
+// (c) 2017 Blai Bonet
+
+#ifndef FRONTIER_H
+#define FRONTIER_H
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+// Frontier for breadth-first search. Entries are kept in buckets indexed
+// by depth, each one a contiguous vector, and the shallowest non-empty
+// bucket is popped first. Within a bucket, entries are popped in FIFO
+// order, or in decreasing order of path reward when ties are broken using
+// rewards (the bucket is then a binary heap). Push and pop are O(1) in
+// FIFO mode and O(log b) for a bucket of size b otherwise. Entries of type
+// T provide depth() (non-negative) and path_reward(). A frontier can be
+// kept across decisions and re-rooted at a descendant of the old root.
+
+template<typename T>
+class Frontier {
+  public:
+    Frontier(bool break_ties_using_rewards)
+      : break_ties_using_rewards_(break_ties_using_rewards),
+        current_(0),
+        size_(0) {
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+    size_t size() const {
+        return size_;
+    }
+
+    void push(const T &entry) {
+        int depth = entry.depth();
+        assert(depth >= 0);
+        if( depth >= int(buckets_.size()) ) buckets_.resize(1 + depth);
+        bucket_t &bucket = buckets_[depth];
+        bucket.entries_.push_back(entry);
+        if( break_ties_using_rewards_ )
+            std::push_heap(bucket.entries_.begin(), bucket.entries_.end(), PathRewardComparator());
+        current_ = std::min(current_, size_t(depth));
+        ++size_;
+    }
+
+    void clear() {
+        buckets_.clear();
+        current_ = 0;
+        size_ = 0;
+    }
+
+    // apply visitor to each entry (in no particular order)
+    template<typename V>
+    void visit(V &visitor) {
+        for( size_t depth = current_; depth < buckets_.size(); ++depth ) {
+            bucket_t &bucket = buckets_[depth];
+            for( size_t k = bucket.head_; k < bucket.entries_.size(); ++k )
+                visitor(bucket.entries_[k]);
+        }
+    }
+
+    // re-root frontier at depth shift: entries that satisfy keep are moved
+    // shift buckets up and the others are dropped. Entries are only passed
+    // to keep, so dropped entries may refer to nodes that no longer exist
+    template<typename P>
+    void reroot(size_t shift, const P &keep) {
+        assert(shift > 0);
+        size_ = 0;
+        for( size_t depth = 0; depth < buckets_.size(); ++depth ) {
+            bucket_t &bucket = buckets_[depth];
+            size_t n = 0;
+            if( depth >= shift ) {
+                for( size_t k = bucket.head_; k < bucket.entries_.size(); ++k ) {
+                    if( keep(bucket.entries_[k]) )
+                        bucket.entries_[n++] = bucket.entries_[k];
+                }
+            }
+            bucket.entries_.erase(bucket.entries_.begin() + n, bucket.entries_.end());
+            bucket.head_ = 0;
+            size_ += n;
+        }
+        buckets_.erase(buckets_.begin(), buckets_.begin() + std::min(shift, buckets_.size()));
+        current_ = 0;
+
+        // path rewards of kept entries are relative to the new root
+        if( break_ties_using_rewards_ ) {
+            for( size_t depth = 0; depth < buckets_.size(); ++depth )
+                std::make_heap(buckets_[depth].entries_.begin(), buckets_[depth].entries_.end(), PathRewardComparator());
+        }
+    }
+
+    T pop() {
+        assert(!empty());
+        while( buckets_[current_].empty() ) ++current_;
+        bucket_t &bucket = buckets_[current_];
+        --size_;
+        if( break_ties_using_rewards_ ) {
+            std::pop_heap(bucket.entries_.begin(), bucket.entries_.end(), PathRewardComparator());
+            T entry = bucket.entries_.back();
+            bucket.entries_.pop_back();
+            return entry;
+        } else {
+            T entry = bucket.entries_[bucket.head_++];
+            if( bucket.empty() ) bucket.clear();
+            return entry;
+        }
+    }
+
+  private:
+    struct PathRewardComparator {
+        bool operator()(const T &lhs, const T &rhs) const {
+            return lhs.path_reward() < rhs.path_reward();
+        }
+    };
+
+    // entries before head_ were popped (FIFO mode); memory is reused once
+    // the bucket is drained
+    struct bucket_t {
+        std::vector<T> entries_;
+        size_t head_;
+        bucket_t() : head_(0) { }
+        bool empty() const {
+            return head_ == entries_.size();
+        }
+        void clear() {
+            entries_.clear();
+            head_ = 0;
+        }
+    };
+
+    const bool break_ties_using_rewards_;
+    std::vector<bucket_t> buckets_;
+    size_t current_;                         // no entries in buckets before current_
+    size_t size_;
+};
+
+#endif
+
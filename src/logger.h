@@ -9,6 +9,19 @@
 #include "utils.h"
 
 // Inspired by logger in Arcade Learning Environment
+//
+// Messages below LOGGER_MIN_MODE (a mode_t value, default 0 = Debug) are
+// removed at compile time when written through the LOGGER() macro, which
+// also skips evaluation of the message's arguments when the message is not
+// emitted:
+//
+//   LOGGER(Logger::Continuation(Logger::Debug)) << node->depth_ << std::flush;
+
+#ifndef LOGGER_MIN_MODE
+#define LOGGER_MIN_MODE 0
+#endif
+
+#define LOGGER(mode) if( !Logger::enabled(mode) ) { } else (mode)
 
 class Logger {
   public:
@@ -64,6 +77,11 @@ class Logger {
     static void set_output_stream(std::ostream &output_stream) {
         Logger::output_stream_ = &output_stream;
     }
+    // stream provider (e.g. per-thread streams of AsyncLogWriter) takes
+    // precedence over output stream when set
+    static void set_output_stream_provider(std::ostream& (*provider)()) {
+        Logger::output_stream_provider_ = provider;
+    }
     static void set_mode(mode_t mode) {
         Logger::current_mode_ = mode;
     }
@@ -84,70 +102,105 @@ class Logger {
     }
 
     static bool available() {
-        return Logger::output_stream_ != nullptr;
+        return (Logger::output_stream_ != nullptr) || (Logger::output_stream_provider_ != nullptr);
     }
     static std::ostream& output_stream() {
-        return *Logger::output_stream_;
+        return Logger::output_stream_provider_ != nullptr ? Logger::output_stream_provider_() : *Logger::output_stream_;
+    }
+
+    // true if messages in given mode survive compile-time elimination
+    static constexpr bool compiled(mode_t mode) {
+        return mode >= LOGGER_MIN_MODE;
     }
 
-    static std::string prefix(mode_t log) {
-        std::string str;
+    // true if a message in given mode would be emitted
+    static bool enabled(mode_t mode, int debug_severity = 0) {
+        return Logger::compiled(mode) &&
+          Logger::available() &&
+          (mode >= Logger::current_mode_) &&
+          ((mode != Logger::Debug) || (debug_severity >= Logger::current_debug_threshold_));
+    }
+    static bool enabled(const Mode &mode) {
+        return Logger::enabled(mode.mode_, mode.debug_severity_);
+    }
+
+    static const char* prefix(mode_t log) {
         if( log == Debug )
-            str += Logger::blue() + "Logger::Debug: ";
+            return "Logger::Debug: ";
         else if( log == Info )
-            str += Logger::green() + "Logger::Info: ";
+            return "Logger::Info: ";
         else if( log == Warning )
-            str += Logger::magenta() + "Logger::Warning: ";
+            return "Logger::Warning: ";
         else if( log == Error )
-            str += Logger::red() + "Logger::Error: ";
+            return "Logger::Error: ";
         else if( log == Stats )
-            str += Logger::yellow() + "Logger::Stats: ";
-        return str + Logger::normal();
+            return "Logger::Stats: ";
+        return "";
+    }
+    static const char* prefix_color(mode_t log) {
+        if( log == Debug )
+            return Utils::ansi_blue;
+        else if( log == Info )
+            return Utils::ansi_green;
+        else if( log == Warning )
+            return Utils::ansi_magenta;
+        else if( log == Error )
+            return Utils::ansi_red;
+        else if( log == Stats )
+            return Utils::ansi_yellow;
+        return Utils::ansi_normal;
+    }
+    static void print_prefix(std::ostream &os, mode_t log) {
+        if( Logger::use_color_ )
+            os << Logger::prefix_color(log) << Logger::prefix(log) << Utils::ansi_normal;
+        else
+            os << Logger::prefix(log);
     }
 
-    static std::string color(color_t color) {
+    static const char* color(color_t color) {
         if( Logger::use_color_ ) {
             if( color == Logger::color_normal )
-                return Utils::normal();
+                return Utils::ansi_normal;
             else if( color == Logger::color_red )
-                return Utils::red();
+                return Utils::ansi_red;
             else if( color == Logger::color_green )
-                return Utils::green();
+                return Utils::ansi_green;
             else if( color == Logger::color_yellow )
-                return Utils::yellow();
+                return Utils::ansi_yellow;
             else if( color == Logger::color_blue )
-                return Utils::blue();
+                return Utils::ansi_blue;
             else if( color == Logger::color_magenta )
-                return Utils::magenta();
+                return Utils::ansi_magenta;
             else if( color == Logger::color_cyan )
-                return Utils::cyan();
+                return Utils::ansi_cyan;
         }
         return "";
     }
-    static std::string normal() {
+    static const char* normal() {
         return Logger::color(Logger::color_normal);
     }
-    static std::string red() {
+    static const char* red() {
         return Logger::color(Logger::color_red);
     }
-    static std::string green() {
+    static const char* green() {
         return Logger::color(Logger::color_green);
     }
-    static std::string yellow() {
+    static const char* yellow() {
         return Logger::color(Logger::color_yellow);
     }
-    static std::string blue() {
+    static const char* blue() {
         return Logger::color(Logger::color_blue);
     }
-    static std::string magenta() {
+    static const char* magenta() {
         return Logger::color(Logger::color_magenta);
     }
-    static std::string cyan() {
+    static const char* cyan() {
         return Logger::color(Logger::color_cyan);
     }
 
   protected:
     static std::ostream *output_stream_;
+    static std::ostream& (*output_stream_provider_)();
     static mode_t current_mode_;
     static int current_debug_threshold_;
     static bool use_color_;
@@ -155,21 +208,24 @@ class Logger {
 
 template<typename T>
 inline Logger::Mode operator<<(Logger::mode_t log, const T &value) {
-    if( Logger::available() && (log >= Logger::current_mode()) )
-        Logger::output_stream() << Logger::prefix(log) << value;
+    if( Logger::compiled(log) && Logger::available() && (log >= Logger::current_mode()) ) {
+        std::ostream &os = Logger::output_stream();
+        Logger::print_prefix(os, log);
+        os << value;
+    }
     return Logger::Mode(log, 0, true);
 }
 
 template<typename T>
 inline Logger::Mode operator<<(Logger::Mode mode, const T &value) {
-    if( Logger::available() && (mode.mode_ >= Logger::current_mode()) ) {
+    if( Logger::compiled(mode.mode_) && Logger::available() && (mode.mode_ >= Logger::current_mode()) ) {
         if( (mode.mode_ == Logger::Debug) && (mode.debug_severity_ >= Logger::current_debug_threshold()) ) {
             if( !mode.continuation_ )
-                Logger::output_stream() << Logger::prefix(mode.mode_);
+                Logger::print_prefix(Logger::output_stream(), mode.mode_);
             Logger::output_stream() << value;
         } else if( mode.mode_ != Logger::Debug ) {
             if( !mode.continuation_ )
-                Logger::output_stream() << Logger::prefix(mode.mode_);
+                Logger::print_prefix(Logger::output_stream(), mode.mode_);
             Logger::output_stream() << value;
         }
     }
@@ -177,13 +233,13 @@ inline Logger::Mode operator<<(Logger::Mode mode, const T &value) {
 }
 
 inline Logger::Mode operator<<(Logger::mode_t log, std::ostream& (*manip)(std::ostream&)) {
-    if( Logger::available() && (log >= Logger::current_mode()) )
+    if( Logger::compiled(log) && Logger::available() && (log >= Logger::current_mode()) )
         manip(Logger::output_stream());
     return Logger::Mode(log, 0, true);
 }
 
 inline Logger::Mode operator<<(Logger::Mode mode, std::ostream& (*manip)(std::ostream&)) {
-    if( Logger::available() && (mode.mode_ >= Logger::current_mode()) ) {
+    if( Logger::compiled(mode.mode_) && Logger::available() && (mode.mode_ >= Logger::current_mode()) ) {
         if( (mode.mode_ == Logger::Debug) && (mode.debug_severity_ >= Logger::current_debug_threshold()) ) {
             manip(Logger::output_stream());
         } else if( mode.mode_ != Logger::Debug ) {
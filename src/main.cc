@@ -1,8 +1,11 @@
 // (c) 2017 Blai Bonet
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <limits>
+#include <map>
+#include <sstream>
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
 #include <boost/tokenizer.hpp>
@@ -11,7 +14,11 @@
 #include "planner.h"
 #include "bfsIW.h"
 #include "rolloutIW.h"
+#include "async_log.h"
 #include "logger.h"
+#include "profiler.h"
+#include "random.h"
+#include "stats.h"
 #include "utils.h"
 
 #ifdef __USE_SDL
@@ -37,6 +44,8 @@ size_t g_acc_frames = 0;
 size_t g_acc_random_decisions = 0;
 size_t g_acc_height = 0;
 size_t g_acc_expanded = 0;
+size_t g_acc_generated = 0;
+double g_acc_decision_time = 0;
 
 
 void reset_global_variables() {
@@ -49,6 +58,8 @@ void reset_global_variables() {
     g_acc_random_decisions = 0;
     g_acc_height = 0;
     g_acc_expanded = 0;
+    g_acc_generated = 0;
+    g_acc_decision_time = 0;
 }
 
 void run_episode(ALEInterface &env,
@@ -59,6 +70,7 @@ void run_episode(ALEInterface &env,
                  bool execute_single_action,
                  size_t frameskip,
                  size_t max_execution_length_in_frames,
+                 size_t max_decisions,
                  vector<Action> &prefix) {
     assert(prefix.empty());
     reset_global_variables();
@@ -89,6 +101,7 @@ void run_episode(ALEInterface &env,
     for( size_t frame = 0; !env.game_over() && (frame < max_execution_length_in_frames); frame += frameskip ) {
         // if empty branch, get branch
         if( branch.empty() ) {
+            if( (max_decisions > 0) && (g_acc_decisions == max_decisions) ) break;
             ++g_acc_decisions;
 
             if( (node != nullptr) && (lookahead_caching == 1) ) {
@@ -98,13 +111,18 @@ void run_episode(ALEInterface &env,
                 assert(node->parent_->state_ != nullptr);
             }
 
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
             node = planner.get_branch(env, prefix, node, last_reward, branch);
+            uint64_t latency = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+            Profiler::record_decision_latency(latency);
+            g_acc_decision_time += double(latency) / 1e9;
             g_acc_simulator_time += planner.simulator_time();
             g_acc_simulator_calls += planner.simulator_calls();
             g_max_simulator_calls = std::max(g_max_simulator_calls, planner.simulator_calls());
             g_acc_random_decisions += planner.random_decision() ? 1 : 0;
             g_acc_height += planner.height();
             g_acc_expanded += planner.expanded();
+            g_acc_generated += planner.generated();
 
             if( branch.empty() ) {
                 Logger::Error << "no more available actions!" << endl;
@@ -141,7 +159,15 @@ void run_episode(ALEInterface &env,
         prefix.push_back(action);
         g_acc_reward += last_reward;
         g_acc_frames += frameskip;
-        Logger::Stats << "step-stats: acc-reward=" << g_acc_reward << ", acc-frames=" << g_acc_frames << endl;
+        LOGGER(Logger::Stats) << "step-stats: acc-reward=" << g_acc_reward << ", acc-frames=" << g_acc_frames << endl;
+        if( StatsSink::available() ) {
+            StatsSink::Record record("step");
+            record.add("action", int(action))
+              .add("reward", last_reward)
+              .add("acc-reward", g_acc_reward)
+              .add("acc-frames", g_acc_frames);
+            StatsSink::write(record);
+        }
 
         // advance/destroy lookhead tree
         if( node != nullptr ) {
@@ -173,6 +199,95 @@ void parse_action_sequence(const string &fixed_action_sequence, vector<Action> &
         actions.push_back(static_cast<Action>(atoi(it->c_str())));
 }
 
+// benchmark results are lines "bench: key=value key=value ..." with one line per ROM
+void parse_bench_line(const string &line, map<string, string> &fields) {
+    istringstream is(line);
+    string token;
+    is >> token;
+    if( token != "bench:" ) return;
+    while( is >> token ) {
+        size_t pos = token.find('=');
+        if( pos != string::npos )
+            fields[token.substr(0, pos)] = token.substr(pos + 1);
+    }
+}
+
+bool read_bench_baseline(const string &filename, map<string, map<string, string> > &baseline) {
+    ifstream is(filename);
+    if( !is ) return false;
+    for( string line; getline(is, line); ) {
+        map<string, string> fields;
+        parse_bench_line(line, fields);
+        if( fields.count("rom") > 0 )
+            baseline[fields["rom"]] = fields;
+    }
+    return true;
+}
+
+// compare result for ROM with baseline; returns number of flagged regressions
+int compare_with_bench_baseline(const map<string, string> &result, const map<string, string> &baseline, float tolerance) {
+    const string &rom = result.at("rom");
+
+    // baseline is only meaningful for same configuration (every option
+    // that changes behavior)
+    const char *config[] = {
+        "planner", "features", "frameskip", "seed", "simulator-budget", "max-decisions",
+        "minimal-action-set", "frames-for-background-image", "initial-random-noops",
+        "execute-single-action", "lookahead-caching", "prefix-length-to-execute",
+        "time-budget", "memory-budget", "discount", "alpha", "max-rep", "nodes-threshold",
+        "novelty-subtables", "novelty-sketch-width", "novelty-sketch-rows",
+        "feature-cache-size", "transposition-table", "transition-cache-size", "transition-cache-states",
+        "action-equivalence", "warm-start-novelty", "random-actions", "use-alpha-to-update-reward-for-death",
+        "max-depth", "break-ties-using-rewards", "persistent-frontier"
+    };
+    for( size_t k = 0; k < sizeof(config) / sizeof(config[0]); ++k ) {
+        if( (baseline.count(config[k]) == 0) || (baseline.at(config[k]) != result.at(config[k])) ) {
+            Logger::Warning << "bench: rom=" << rom << " skipping comparison with baseline: different " << config[k] << endl;
+            return 0;
+        }
+    }
+
+    // behavior must be identical
+    int regressions = 0;
+    const char *behavior[] = { "score", "frames", "decisions", "simulator-calls", "generated" };
+    for( size_t k = 0; k < sizeof(behavior) / sizeof(behavior[0]); ++k ) {
+        if( (baseline.count(behavior[k]) > 0) && (baseline.at(behavior[k]) != result.at(behavior[k])) ) {
+            Logger::Warning << "bench: rom=" << rom << " BEHAVIOR CHANGE " << behavior[k] << "=" << result.at(behavior[k]) << " baseline=" << baseline.at(behavior[k]) << endl;
+            ++regressions;
+        }
+    }
+
+    // performance must be within tolerance (sign tells whether more is better)
+    const char *performance[] = { "sims/s", "nodes/s", "latency-p50", "latency-p99", "peak-rss-kb" };
+    const int sign[] = { 1, 1, -1, -1, -1 };
+    for( size_t k = 0; k < sizeof(performance) / sizeof(performance[0]); ++k ) {
+        if( baseline.count(performance[k]) == 0 ) continue;
+        double value = atof(result.at(performance[k]).c_str());
+        double reference = atof(baseline.at(performance[k]).c_str());
+        double change = reference == 0 ? 0 : (value - reference) / reference;
+        if( sign[k] * change < -tolerance ) {
+            Logger::Warning << "bench: rom=" << rom << " REGRESSION " << performance[k] << "=" << value << " baseline=" << reference << " (" << 100 * change << "%)" << endl;
+            ++regressions;
+        } else {
+            Logger::Info << "bench: rom=" << rom << " " << performance[k] << "=" << value << " baseline=" << reference << " (" << 100 * change << "%)" << endl;
+        }
+    }
+    return regressions;
+}
+
+// instantiate planner P for given feature set (nullptr if invalid)
+template<template<typename> class P, typename... Args>
+Planner* create_planner(int screen_features, Args&&... args) {
+    switch( screen_features ) {
+        case 0: return new P<Features::RAM>(std::forward<Args>(args)...);
+        case 1: return new P<Features::Basic>(std::forward<Args>(args)...);
+        case 2: return new P<Features::Bpros>(std::forward<Args>(args)...);
+        case 3: return new P<Features::Bprot>(std::forward<Args>(args)...);
+        case 4: return new P<Features::RamBits>(std::forward<Args>(args)...);
+        default: return nullptr;
+    }
+}
+
 void print_options(ostream &os, const po::variables_map &opt_varmap) {
     os << "options:" << endl;
     bool something_printed = false;
@@ -201,6 +316,27 @@ void usage(ostream &os, const po::options_description &opt_desc) {
        << endl;
 }
 
+// destroy async log writer (which flushes pending messages) and close log
+// file; must be called before any exit() once the log file is open since
+// exit() doesn't run destructors of heap-allocated objects
+void close_log(AsyncLogWriter *&async_log_writer, ofstream *&logger_output_stream) {
+    if( async_log_writer != nullptr ) {
+        Logger::set_output_stream_provider(nullptr);
+        size_t dropped_messages = async_log_writer->dropped_messages();
+        size_t dropped_bytes = async_log_writer->dropped_bytes();
+        delete async_log_writer;
+        async_log_writer = nullptr;
+        if( dropped_messages > 0 )
+            Logger::Warning << "async log: dropped " << dropped_messages << " message(s) (" << dropped_bytes << " bytes)" << endl;
+    }
+    if( logger_output_stream != nullptr ) {
+        Logger::set_output_stream(cout);
+        logger_output_stream->close();
+        delete logger_output_stream;
+        logger_output_stream = nullptr;
+    }
+}
+
 int main(int argc, char **argv) {
     // setup logger
     ostream *default_log_file = &cout;
@@ -212,14 +348,29 @@ int main(int argc, char **argv) {
     // rom and log files
     string opt_logger_mode;
     string opt_log_file;
+    bool opt_async_log = false;
+    int opt_async_log_buffer;
+    string opt_async_log_policy;
+    string opt_stats_file;
     string opt_rom;
 
+    // benchmark
+    bool opt_bench = false;
+    string opt_bench_rom_dir;
+    string opt_bench_roms;
+    int opt_bench_decisions;
+    string opt_bench_baseline;
+    string opt_bench_output;
+    float opt_bench_tolerance;
+
     // planner
     string opt_planner_str;
 
     // general options
     int opt_random_seed;
     int opt_debug_threshold;
+    bool opt_profile = false;
+    bool opt_perf_counters = false;
     string opt_ale_logger_mode;
     int opt_frameskip;
     bool opt_display = true;
@@ -246,6 +397,7 @@ int main(int argc, char **argv) {
     float opt_prefix_length_to_execute;
     int opt_simulator_budget;
     float opt_time_budget;
+    int opt_memory_budget;
 
     // common options for planners
     float opt_alpha;
@@ -253,6 +405,17 @@ int main(int argc, char **argv) {
     int opt_max_rep;
     int opt_nodes_threshold;
     bool opt_novelty_subtables = false;
+    int opt_novelty_sketch_width;
+    int opt_novelty_sketch_rows;
+    bool opt_novelty_sketch_verify = false;
+    int opt_feature_cache_size;
+    bool opt_transposition_table = false;
+    int opt_transition_cache_size;
+    bool opt_transition_cache_states = false;
+    bool opt_action_equivalence = false;
+    bool opt_warm_start_novelty = false;
+    bool opt_warm_start_verify = false;
+    bool opt_novelty_huge_pages = false;
     bool opt_random_actions = false;
     bool opt_use_alpha_to_update_reward_for_death = false;
 
@@ -261,6 +424,7 @@ int main(int argc, char **argv) {
 
     // options for bfs planner
     bool opt_break_ties_using_rewards = false;
+    bool opt_persistent_frontier = false;
 
     // declare supported options
     po::options_description opt_desc("Allowed options");
@@ -268,12 +432,27 @@ int main(int argc, char **argv) {
       // rom and log files
       ("logger-mode", po::value<string>(&opt_logger_mode)->default_value("info"), "Change logger mode to 'debug', 'info', 'warning', 'error', 'stats', or 'silent' (default is 'info')")
       ("log-file", po::value<string>(&opt_log_file), "Set path to log file (default is \"\" for std::cout)")
+      ("async-log", "Write log file from background thread (default is to write synchronously)")
+      ("async-log-buffer", po::value<int>(&opt_async_log_buffer)->default_value(1024), "Set size in KB of per-thread buffer for async log (default is 1024)")
+      ("async-log-policy", po::value<string>(&opt_async_log_policy)->default_value("block"), "Set policy for full async log buffer, either 'block' or 'drop' (default is 'block')")
+      ("stats-file", po::value<string>(&opt_stats_file), "Set path to file for NDJSON stats records (default is \"\" for no records)")
       ("rom", po::value<string>(&opt_rom), "Set Atari ROM")
 
+      // benchmark
+      ("bench", "Run benchmark on fixed set of ROMs, one episode each, instead of single ROM")
+      ("bench-rom-dir", po::value<string>(&opt_bench_rom_dir)->default_value("../atari-roms/ALE-Atari-Width/group_1"), "Set folder for benchmark ROMs (default is group_1)")
+      ("bench-roms", po::value<string>(&opt_bench_roms)->default_value("alien,asteroids,bank_heist,battle_zone,crazy_climber,frostbite,gopher,hero"), "Set comma-separated list of benchmark ROMs")
+      ("bench-decisions", po::value<int>(&opt_bench_decisions)->default_value(50), "Set number of decisions per ROM in benchmark (default is 50)")
+      ("bench-baseline", po::value<string>(&opt_bench_baseline), "Set path to baseline file with benchmark results to compare with (default is \"\" for none)")
+      ("bench-output", po::value<string>(&opt_bench_output), "Set path to file for benchmark results, usable as baseline (default is \"\" for none)")
+      ("bench-tolerance", po::value<float>(&opt_bench_tolerance)->default_value(0.10), "Set relative tolerance for performance regressions in benchmark (default is 0.10)")
+
       // general options
       ("help", "Help message")
       ("seed", po::value<int>(&opt_random_seed)->default_value(0), "Set random seed (default is 0)")
       ("debug-threshold", po::value<int>(&opt_debug_threshold)->default_value(0), "Set threshold for debug mode (default is 0)")
+      ("profile", "Turn on phase profiler and decision latency histogram (default is off)")
+      ("perf-counters", "Turn on phase profiler with hardware counters (cycles, instructions, cache and branch misses) if available (default is off)")
       ("ale-logger-mode", po::value<string>(&opt_ale_logger_mode)->default_value("error"), "Change ALE logger mode to 'info', 'warning', 'error', or 'silent' (default is 'error')")
       ("frameskip", po::value<int>(&opt_frameskip)->default_value(15), "Set frame skip rate (default is 15)")
       ("nodisplay", "Turn off display (default is display)")
@@ -290,7 +469,7 @@ int main(int argc, char **argv) {
       ("fixed-action-sequence", po::value<string>(&opt_fixed_action_sequence)->default_value("none"), "Pass fixed action sequence that provides actions (default is \"none\" for no such sequence)")
 
       // features
-      ("features", po::value<int>(&opt_screen_features)->default_value(3), "Set feature set: 0=RAM, 1=basic, 2=basic+B-PROS, 3=basic+B-PROS+B-PROT (default is 3)")
+      ("features", po::value<int>(&opt_screen_features)->default_value(3), "Set feature set: 0=RAM, 1=basic, 2=basic+B-PROS, 3=basic+B-PROS+B-PROT, 4=RAM bits (default is 3)")
       ("frames-background-image", po::value<int>(&opt_frames_for_background_image)->default_value(100), "Set number of random frames to compute background image (default is 100)")
 
       // options for online execution
@@ -298,12 +477,24 @@ int main(int argc, char **argv) {
       ("lookahead-caching", po::value<int>(&opt_lookahead_caching)->default_value(2), "Set lookahead caching: 0=none, 1=partial, 2=full (default is 2)")
       ("simulator-budget", po::value<int>(&opt_simulator_budget)->default_value(150000), "Set budget for #calls to simulator for online decision making (default is 150k)")
       ("time-budget", po::value<float>(&opt_time_budget)->default_value(numeric_limits<float>::infinity()), "Set time budget for online decision making (default is infinite)")
+      ("memory-budget", po::value<int>(&opt_memory_budget)->default_value(0), "Set budget in MB for lookahead tree and novelty tables; growth stops when reached (default is 0 = unlimited)")
       ("execute-single-action", "Execute only one action from best branch in lookahead (default is to execute prefix until first reward)")
       ("prefix-length-to-execute", po::value<float>(&opt_prefix_length_to_execute)->default_value(0.0), "Set \% of prefix to execute (default is 0 = execute until positive reward)")
 
       // planners
       ("planner", po::value<string>(&opt_planner_str)->default_value(string("rollout")), "Set planner, either 'rollout' or 'bfs' (default is 'rollout')")
       ("novelty-subtables", "Turn on use of novelty subtables (default is to use single table)")
+      ("novelty-sketch-width", po::value<int>(&opt_novelty_sketch_width)->default_value(0), "Set #entries per row of approximate novelty sketch, rounded up to power of 2 (default is 0 = exact novelty tables)")
+      ("novelty-sketch-rows", po::value<int>(&opt_novelty_sketch_rows)->default_value(4), "Set #rows (hash functions) of approximate novelty sketch (default is 4)")
+      ("novelty-sketch-verify", "Run exact novelty tables alongside sketch and report false-pruning rate (default is off)")
+      ("feature-cache-size", po::value<int>(&opt_feature_cache_size)->default_value(0), "Set #entries of LRU cache of screen features keyed by screen hash (default is 0 = disabled)")
+      ("transposition-table", "Prune nodes that reach a state (RAM and lives) already reached at same or smaller depth (default is off)")
+      ("transition-cache-size", po::value<int>(&opt_transition_cache_size)->default_value(0), "Set #entries of LRU cache of simulator transitions kept across decisions (default is 0 = disabled)")
+      ("transition-cache-states", "Store successor states in transition cache (default is off: states of hits are simulated when needed)")
+      ("action-equivalence", "Merge children that reach the same state (RAM and lives) and reward as a sibling (default is off)")
+      ("warm-start-novelty", "Fill novelty tables with the atoms of the cached lookahead tree at each decision; bfs then keeps all atoms of expanded nodes (default is off)")
+      ("warm-start-novelty-verify", "Run cold novelty tables alongside warm-started tables and report simulator calls saved; cold tables aren't counted in memory budget (default is off)")
+      ("novelty-huge-pages", "Advise transparent huge pages for novelty tables (default is off)")
       ("random-actions", "Use random action when there are no rewards in look-ahead tree (default is off)")
       ("max-rep", po::value<int>(&opt_max_rep)->default_value(30), "Set max rep(etition) of screen features during lookahead (default is 30)")
       ("discount", po::value<float>(&opt_discount)->default_value(1.00), "Set discount factor for lookahead (default is 1.00)")
@@ -316,6 +507,7 @@ int main(int argc, char **argv) {
 
       // optiosn for bfs planner
       ("break-ties-using-rewards", "Break ties in favor of better rewards during bfs (default is no tie breaking)")
+      ("persistent-frontier", "Keep bfs frontier across decisions instead of rebuilding it from tip nodes")
     ;
 
     po::positional_options_description opt_pos;
@@ -334,12 +526,24 @@ int main(int argc, char **argv) {
     // set values for boolean options
     opt_display = !opt_varmap.count("nodisplay");
     opt_sound = opt_varmap.count("sound");
+    opt_profile = opt_varmap.count("profile");
+    opt_perf_counters = opt_varmap.count("perf-counters");
+    opt_async_log = opt_varmap.count("async-log");
+    opt_bench = opt_varmap.count("bench");
     opt_use_minimal_action_set = opt_varmap.count("use-minimal-action-set");
     opt_execute_single_action = opt_varmap.count("execute-single-action");
     opt_novelty_subtables = opt_varmap.count("novelty-subtables");
+    opt_novelty_sketch_verify = opt_varmap.count("novelty-sketch-verify");
+    opt_transposition_table = opt_varmap.count("transposition-table");
+    opt_transition_cache_states = opt_varmap.count("transition-cache-states");
+    opt_action_equivalence = opt_varmap.count("action-equivalence");
+    opt_warm_start_novelty = opt_varmap.count("warm-start-novelty");
+    opt_warm_start_verify = opt_varmap.count("warm-start-novelty-verify");
+    opt_novelty_huge_pages = opt_varmap.count("novelty-huge-pages");
     opt_random_actions = opt_varmap.count("random-actions");
     opt_use_alpha_to_update_reward_for_death = opt_varmap.count("use-alpha-to-update-reward-for-death");
     opt_break_ties_using_rewards = opt_varmap.count("break-ties-using-rewards");
+    opt_persistent_frontier = opt_varmap.count("persistent-frontier");
 
     // set logger mode and log mode
     Logger::mode_t logger_mode = Logger::Silent;
@@ -361,24 +565,58 @@ int main(int argc, char **argv) {
     }
     Logger::set_mode(logger_mode);
     Logger::set_debug_threshold(opt_debug_threshold);
+    Profiler::set_enabled(opt_profile || opt_perf_counters);
+    PageMemory::set_huge_pages(opt_novelty_huge_pages);
 
+    ofstream *logger_output_stream = nullptr;
+    AsyncLogWriter *async_log_writer = nullptr;
     if( opt_varmap.count("log-file") && (opt_log_file != "") ) {
-        ostream *logger_output_stream = new ofstream(opt_log_file);
+        logger_output_stream = new ofstream(opt_log_file);
         Logger::set_output_stream(*logger_output_stream);
         Logger::set_use_color(false);
+
+        if( opt_async_log ) {
+            AsyncLogWriter::policy_t policy = AsyncLogWriter::Block;
+            if( opt_async_log_policy == "drop" ) {
+                policy = AsyncLogWriter::Drop;
+            } else if( opt_async_log_policy != "block" ) {
+                Logger::Error << "invalid async log policy '" << opt_async_log_policy << "'" << endl;
+                close_log(async_log_writer, logger_output_stream);
+                exit(-1);
+            }
+            size_t ring_size = 1;
+            while( ring_size < 1024 * size_t(std::max(opt_async_log_buffer, 1)) )
+                ring_size <<= 1;
+            async_log_writer = new AsyncLogWriter(*logger_output_stream, ring_size, policy);
+            Logger::set_output_stream_provider(&AsyncLogWriter::thread_stream);
+        }
+    }
+
+    ofstream *stats_output_stream = nullptr;
+    if( opt_varmap.count("stats-file") && (opt_stats_file != "") ) {
+        stats_output_stream = new ofstream(opt_stats_file);
+        if( !*stats_output_stream ) {
+            Logger::Error << "unable to open stats file '" << opt_stats_file << "'" << endl;
+            close_log(async_log_writer, logger_output_stream);
+            exit(1);
+        }
+        StatsSink::set_output_stream(*stats_output_stream);
     }
 
     // check whether there is something to be done
-    if( opt_varmap.count("help") || (opt_rom == "") ) {
+    if( opt_varmap.count("help") || ((opt_rom == "") && !opt_bench) ) {
         usage(cout, opt_desc);
+        close_log(async_log_writer, logger_output_stream);
         exit(1);
     }
 
     // print command-line options
     print_options(Logger::output_stream(), opt_varmap);
 
-    // set random seed for lrand48() and drand48()
-    srand48(opt_random_seed);
+    // hardware counters for profiler (on this thread)
+    string perf_counters_error;
+    if( opt_perf_counters && !Profiler::set_counters_enabled(true, perf_counters_error) )
+        Logger::Warning << "perf counters unavailable (" << perf_counters_error << "); profiling without counters" << endl;
 
     // set logger mode for ALE
     ale::Logger::mode ale_logger_mode = ale::Logger::Silent;
@@ -392,169 +630,363 @@ int main(int argc, char **argv) {
         ale_logger_mode = ale::Logger::Silent;
     } else {
         Logger::Error << "invalid ALE logger mode '" << opt_ale_logger_mode << "'" << endl;
+        close_log(async_log_writer, logger_output_stream);
         exit(-1);
     }
 
-    // create ALEs
-    ALEInterface env(ale_logger_mode), sim(ale::Logger::Silent);
+    // ROMs: either given ROM or fixed set of ROMs for benchmark. Each ROM in
+    // benchmark is played for one episode and fixed number of decisions with
+    // given seed and simulator budget; results can be saved and compared
+    // with a baseline to flag changes in behavior and performance regressions
+    vector<string> roms;
+    map<string, map<string, string> > bench_baseline;
+    ofstream *bench_output_stream = nullptr;
+    int bench_regressions = 0;
+    if( opt_bench ) {
+        boost::char_separator<char> separator(",");
+        boost::tokenizer<boost::char_separator<char> > tok(opt_bench_roms, separator);
+        for( boost::tokenizer<boost::char_separator<char> >::iterator it = tok.begin(); it != tok.end(); ++it )
+            roms.push_back((fs::path(opt_bench_rom_dir) / (*it + ".bin")).string());
+        opt_episodes = 1;
+        if( opt_time_budget != numeric_limits<float>::infinity() )
+            Logger::Warning << "bench: finite time budget makes results not reproducible" << endl;
+        if( (opt_bench_baseline != "") && !read_bench_baseline(opt_bench_baseline, bench_baseline) ) {
+            Logger::Error << "unable to read benchmark baseline '" << opt_bench_baseline << "'" << endl;
+            close_log(async_log_writer, logger_output_stream);
+            exit(1);
+        }
+        if( opt_bench_output != "" )
+            bench_output_stream = new ofstream(opt_bench_output);
+    } else {
+        roms.push_back(opt_rom);
+    }
+
+    for( size_t r = 0; r < roms.size(); ++r ) {
+        if( opt_bench ) Utils::reset_peak_rss();
+
+        // random stream for choices made outside planners; planners get
+        // their own stream for each episode (see below)
+        Random::Engine rng(opt_random_seed);
 
-    // get/set desired settings
-    env.setInt("frame_skip", opt_frameskip);
-    env.setInt("random_seed", opt_random_seed);
-    env.setFloat("repeat_action_probability", 0.00);
-    sim.setInt("frame_skip", opt_frameskip);
-    sim.setInt("random_seed", opt_random_seed);
-    sim.setFloat("repeat_action_probability", 0.00);
-    fs::path rom_path(opt_rom);
+        // create ALEs
+        ALEInterface env(ale_logger_mode), sim(ale::Logger::Silent);
+
+        // get/set desired settings
+        env.setInt("frame_skip", opt_frameskip);
+        env.setInt("random_seed", opt_random_seed);
+        env.setFloat("repeat_action_probability", 0.00);
+        sim.setInt("frame_skip", opt_frameskip);
+        sim.setInt("random_seed", opt_random_seed);
+        sim.setFloat("repeat_action_probability", 0.00);
+        fs::path rom_path(roms[r]);
 
 #ifdef __USE_SDL
-    env.setBool("display_screen", opt_display);
-    env.setBool("sound", opt_sound);
-    if( opt_rec_dir != "" ) {
-        string full_rec_dir = opt_rec_dir + "/" + rom_path.filename().string();
-        env.setString("record_screen_dir", full_rec_dir.c_str());
-        if( opt_rec_sound_filename != "" )
-            env.setString("record_sound_filename", (full_rec_dir + "/" + opt_rec_sound_filename).c_str());
-        fs::create_directories(full_rec_dir);
-    }
-    sim.setBool("display_screen", false);
-    sim.setBool("sound", false);
+        env.setBool("display_screen", opt_display);
+        env.setBool("sound", opt_sound);
+        if( opt_rec_dir != "" ) {
+            string full_rec_dir = opt_rec_dir + "/" + rom_path.filename().string();
+            env.setString("record_screen_dir", full_rec_dir.c_str());
+            if( opt_rec_sound_filename != "" )
+                env.setString("record_sound_filename", (full_rec_dir + "/" + opt_rec_sound_filename).c_str());
+            fs::create_directories(full_rec_dir);
+        }
+        sim.setBool("display_screen", false);
+        sim.setBool("sound", false);
 #endif
 
-    // Load the ROM file. (Also resets the system for new settings to take effect.)
-    env.loadROM(rom_path.string().c_str());
-    sim.loadROM(rom_path.string().c_str());
+        // Load the ROM file. (Also resets the system for new settings to take effect.)
+        env.loadROM(rom_path.string().c_str());
+        sim.loadROM(rom_path.string().c_str());
 
-    // initialize static members for screen features
-    if( opt_screen_features > 0 ) {
-        MyALEScreen::create_background_image();
-        MyALEScreen::compute_background_image(sim, opt_frames_for_background_image);
-    }
+        // initialize static members for screen features
+        if( (opt_screen_features > 0) && (opt_screen_features < 4) ) {
+            MyALEScreen::create_background_image();
+            MyALEScreen::compute_background_image(sim, opt_frames_for_background_image, rng);
+        }
 
-    // construct planner
-    Planner *planner = nullptr;
-    if( opt_fixed_action_sequence != "none" ) {
-        vector<Action> actions;
-        parse_action_sequence(opt_fixed_action_sequence, actions);
-        planner = new FixedPlanner(actions);
-    } else {
-        size_t num_tracked_atoms = 0;
-        if( opt_screen_features == 0 ) { // RAM mode
-            num_tracked_atoms = 128 * 256; // this is for RAM: 128 8-bit entries
+        // construct planner
+        Planner *planner = nullptr;
+        if( opt_fixed_action_sequence != "none" ) {
+            vector<Action> actions;
+            parse_action_sequence(opt_fixed_action_sequence, actions);
+            planner = new FixedPlanner(actions);
         } else {
-            num_tracked_atoms = 16 * 14 * 128; // 28,672
-            num_tracked_atoms += opt_screen_features > 1 ? 6856768 : 0;
-            num_tracked_atoms += opt_screen_features > 2 ? 13713408 : 0;
+            if( opt_planner_str == "rollout" ) {
+                planner = create_planner<RolloutIW>(opt_screen_features,
+                                                    sim,
+                                                    opt_frameskip,
+                                                    opt_use_minimal_action_set,
+                                                    opt_simulator_budget,
+                                                    opt_time_budget,
+                                                    size_t(opt_memory_budget) << 20,
+                                                    opt_novelty_subtables,
+                                                    opt_novelty_sketch_width,
+                                                    opt_novelty_sketch_rows,
+                                                    opt_novelty_sketch_verify,
+                                                    opt_feature_cache_size,
+                                                    opt_transposition_table,
+                                                    opt_transition_cache_size,
+                                                    opt_transition_cache_states,
+                                                    opt_action_equivalence,
+                                                    opt_warm_start_novelty,
+                                                    opt_warm_start_verify,
+                                                    opt_random_actions,
+                                                    opt_max_rep,
+                                                    opt_discount,
+                                                    opt_alpha,
+                                                    opt_use_alpha_to_update_reward_for_death,
+                                                    opt_nodes_threshold,
+                                                    opt_max_depth);
+            } else if( opt_planner_str == "bfs" ) {
+                planner = create_planner<BfsIW>(opt_screen_features,
+                                                sim,
+                                                opt_frameskip,
+                                                opt_use_minimal_action_set,
+                                                opt_simulator_budget,
+                                                opt_time_budget,
+                                                size_t(opt_memory_budget) << 20,
+                                                opt_novelty_subtables,
+                                                opt_novelty_sketch_width,
+                                                opt_novelty_sketch_rows,
+                                                opt_novelty_sketch_verify,
+                                                opt_feature_cache_size,
+                                                opt_transposition_table,
+                                                opt_transition_cache_size,
+                                                opt_transition_cache_states,
+                                                opt_action_equivalence,
+                                                opt_warm_start_novelty,
+                                                opt_warm_start_verify,
+                                                opt_random_actions,
+                                                opt_max_rep,
+                                                opt_discount,
+                                                opt_alpha,
+                                                opt_use_alpha_to_update_reward_for_death,
+                                                opt_nodes_threshold,
+                                                opt_break_ties_using_rewards,
+                                                opt_persistent_frontier);
+            } else {
+                Logger::Error << "inexistent planner '" << opt_planner_str << "'" << endl;
+                close_log(async_log_writer, logger_output_stream);
+                exit(1);
+            }
+            if( planner == nullptr ) {
+                Logger::Error << "invalid feature set " << opt_screen_features << endl;
+                close_log(async_log_writer, logger_output_stream);
+                exit(1);
+            }
+        }
+        assert(planner != nullptr);
+        Logger::Info << "planner=" << planner->name() << endl;
+
+        // set number of initial noops
+        assert(opt_initial_random_noops > 0);
+        int initial_noops = rng.uniform(opt_initial_random_noops);
+
+        // play
+        for( int k = 0; k < opt_episodes; ++k ) {
+            vector<Action> prefix;
+            planner->set_random_stream(Random::stream(opt_random_seed, k));
+            StatsSink::set_episode(k);
+            Profiler::reset();
+            float start_time = Utils::read_time_in_seconds();
+            run_episode(env, *planner, initial_noops, opt_lookahead_caching, opt_prefix_length_to_execute, opt_execute_single_action, opt_frameskip, opt_max_execution_length_in_frames, opt_bench ? opt_bench_decisions : 0, prefix);
+            float elapsed_time = Utils::read_time_in_seconds() - start_time;
+            Logger::Stats
+              << "episode-stats:"
+              // rom and log files
+              << " rom=" << roms[r]
+              // planner
+              << " planner=" << opt_planner_str
+              // general options
+              << " debug-threshold=" << opt_debug_threshold
+              << " frameskip=" << opt_frameskip
+              << " seed=" << opt_random_seed
+              << " use-minimal-action-set=" << opt_use_minimal_action_set
+              // episodes and execution length
+              << " episodes=" << opt_episodes
+              << " max-execution-length=" << opt_max_execution_length_in_frames
+              // simulate previous execution
+              << " fixed-action-sequence=\"" << opt_fixed_action_sequence << "\""
+              // features
+              << " features=" << opt_screen_features
+              << " frames-background-image=" << opt_frames_for_background_image
+              // online execution
+              << " initial-noops=" << opt_initial_random_noops
+              << " execute-single-action=" << opt_execute_single_action
+              << " caching=" << opt_lookahead_caching
+              << " prefix-length-to-execute=" << opt_prefix_length_to_execute
+              << " simulator-budget=" << opt_simulator_budget
+              << " time-budget=" << opt_time_budget
+              << " memory-budget=" << opt_memory_budget
+              // common options for planners
+              << " alpha=" << opt_alpha
+              << " discount=" << opt_discount
+              << " max-rep=" << opt_max_rep
+              << " nodes-threshold=" << opt_nodes_threshold
+              << " novelty-subtables=" << opt_novelty_subtables
+              << " novelty-sketch-width=" << opt_novelty_sketch_width
+              << " novelty-sketch-rows=" << opt_novelty_sketch_rows
+              << " feature-cache-size=" << opt_feature_cache_size
+              << " transposition-table=" << opt_transposition_table
+              << " transition-cache-size=" << opt_transition_cache_size
+              << " transition-cache-states=" << opt_transition_cache_states
+              << " action-equivalence=" << opt_action_equivalence
+              << " warm-start-novelty=" << opt_warm_start_novelty
+              << " random-actions=" << opt_random_actions
+              << " use-alpha-to-update-reward-for-death=" << opt_use_alpha_to_update_reward_for_death
+              // rollout planner
+              << " max-depth=" << opt_max_depth
+              // bfs planner
+              << " break-ties-using-rewards=" << opt_break_ties_using_rewards
+              << " persistent-frontier=" << opt_persistent_frontier
+              // data
+              << " score=" << g_acc_reward
+              << " frames=" << g_acc_frames
+              << " decisions=" << g_acc_decisions
+              << " simulator-calls=" << g_acc_simulator_calls
+              << " max-simulator-calls=" << g_max_simulator_calls
+              << " total-time=" << elapsed_time
+              << " simulator-time=" << g_acc_simulator_time
+              << " sum-expanded=" << g_acc_expanded
+              << " sum-height=" << g_acc_height
+              << " random-decisions=" << g_acc_random_decisions
+              << endl;
+            Profiler::print(Logger::Stats);
+
+            if( StatsSink::available() ) {
+                StatsSink::Record record("episode");
+                record.add("rom", roms[r])
+                  .add("planner", opt_planner_str)
+                  .add("debug-threshold", opt_debug_threshold)
+                  .add("frameskip", opt_frameskip)
+                  .add("seed", opt_random_seed)
+                  .add("use-minimal-action-set", opt_use_minimal_action_set)
+                  .add("episodes", opt_episodes)
+                  .add("max-execution-length", opt_max_execution_length_in_frames)
+                  .add("fixed-action-sequence", opt_fixed_action_sequence)
+                  .add("features", opt_screen_features)
+                  .add("frames-background-image", opt_frames_for_background_image)
+                  .add("initial-noops", opt_initial_random_noops)
+                  .add("execute-single-action", opt_execute_single_action)
+                  .add("caching", opt_lookahead_caching)
+                  .add("prefix-length-to-execute", opt_prefix_length_to_execute)
+                  .add("simulator-budget", opt_simulator_budget)
+                  .add("time-budget", opt_time_budget)
+                  .add("memory-budget", opt_memory_budget)
+                  .add("alpha", opt_alpha)
+                  .add("discount", opt_discount)
+                  .add("max-rep", opt_max_rep)
+                  .add("nodes-threshold", opt_nodes_threshold)
+                  .add("novelty-subtables", opt_novelty_subtables)
+                  .add("novelty-sketch-width", opt_novelty_sketch_width)
+                  .add("novelty-sketch-rows", opt_novelty_sketch_rows)
+                  .add("feature-cache-size", opt_feature_cache_size)
+                  .add("transposition-table", opt_transposition_table)
+                  .add("transition-cache-size", opt_transition_cache_size)
+                  .add("transition-cache-states", opt_transition_cache_states)
+                  .add("action-equivalence", opt_action_equivalence)
+                  .add("warm-start-novelty", opt_warm_start_novelty)
+                  .add("random-actions", opt_random_actions)
+                  .add("use-alpha-to-update-reward-for-death", opt_use_alpha_to_update_reward_for_death)
+                  .add("max-depth", opt_max_depth)
+                  .add("break-ties-using-rewards", opt_break_ties_using_rewards)
+                  .add("persistent-frontier", opt_persistent_frontier)
+                  .add("score", g_acc_reward)
+                  .add("frames", g_acc_frames)
+                  .add("decisions", g_acc_decisions)
+                  .add("simulator-calls", g_acc_simulator_calls)
+                  .add("max-simulator-calls", g_max_simulator_calls)
+                  .add("total-time", elapsed_time)
+                  .add("simulator-time", g_acc_simulator_time)
+                  .add("sum-expanded", g_acc_expanded)
+                  .add("sum-height", g_acc_height)
+                  .add("random-decisions", g_acc_random_decisions);
+                Profiler::add_latency_stats(record);
+                StatsSink::write(record);
+                StatsSink::flush();
+            }
         }
 
-        if( opt_planner_str == "rollout" ) {
-            planner = new RolloutIW(sim,
-                                    opt_frameskip,
-                                    opt_use_minimal_action_set,
-                                    num_tracked_atoms,
-                                    opt_screen_features,
-                                    opt_simulator_budget,
-                                    opt_time_budget,
-                                    opt_novelty_subtables,
-                                    opt_random_actions,
-                                    opt_max_rep,
-                                    opt_discount,
-                                    opt_alpha,
-                                    opt_use_alpha_to_update_reward_for_death,
-                                    opt_nodes_threshold,
-                                    opt_max_depth);
-        } else if( opt_planner_str == "bfs" ) {
-            planner = new BfsIW(sim,
-                                opt_frameskip,
-                                opt_use_minimal_action_set,
-                                num_tracked_atoms,
-                                opt_screen_features,
-                                opt_simulator_budget,
-                                opt_time_budget,
-                                opt_novelty_subtables,
-                                opt_random_actions,
-                                opt_max_rep,
-                                opt_discount,
-                                opt_alpha,
-                                opt_use_alpha_to_update_reward_for_death,
-                                opt_nodes_threshold,
-                                opt_break_ties_using_rewards);
-        } else {
-            Logger::Error << "inexistent planner '" << opt_planner_str << "'" << endl;
-            exit(1);
+        // benchmark results
+        if( opt_bench ) {
+            ostringstream bench_line;
+            bench_line << "bench:"
+                       << " rom=" << rom_path.filename().string()
+                       << " planner=" << opt_planner_str
+                       << " features=" << opt_screen_features
+                       << " frameskip=" << opt_frameskip
+                       << " seed=" << opt_random_seed
+                       << " simulator-budget=" << opt_simulator_budget
+                       << " max-decisions=" << opt_bench_decisions
+                       << " minimal-action-set=" << opt_use_minimal_action_set
+                       << " frames-for-background-image=" << opt_frames_for_background_image
+                       << " initial-random-noops=" << opt_initial_random_noops
+                       << " execute-single-action=" << opt_execute_single_action
+                       << " lookahead-caching=" << opt_lookahead_caching
+                       << " prefix-length-to-execute=" << opt_prefix_length_to_execute
+                       << " time-budget=" << opt_time_budget
+                       << " memory-budget=" << opt_memory_budget
+                       << " discount=" << opt_discount
+                       << " alpha=" << opt_alpha
+                       << " max-rep=" << opt_max_rep
+                       << " nodes-threshold=" << opt_nodes_threshold
+                       << " novelty-subtables=" << opt_novelty_subtables
+                       << " novelty-sketch-width=" << opt_novelty_sketch_width
+                       << " novelty-sketch-rows=" << opt_novelty_sketch_rows
+                       << " feature-cache-size=" << opt_feature_cache_size
+                       << " transposition-table=" << opt_transposition_table
+                       << " transition-cache-size=" << opt_transition_cache_size
+                       << " transition-cache-states=" << opt_transition_cache_states
+                       << " action-equivalence=" << opt_action_equivalence
+                       << " warm-start-novelty=" << opt_warm_start_novelty
+                       << " random-actions=" << opt_random_actions
+                       << " use-alpha-to-update-reward-for-death=" << opt_use_alpha_to_update_reward_for_death
+                       << " max-depth=" << opt_max_depth
+                       << " break-ties-using-rewards=" << opt_break_ties_using_rewards
+                       << " persistent-frontier=" << opt_persistent_frontier
+                       << " score=" << g_acc_reward
+                       << " frames=" << g_acc_frames
+                       << " decisions=" << g_acc_decisions
+                       << " simulator-calls=" << g_acc_simulator_calls
+                       << " generated=" << g_acc_generated
+                       << " decision-time=" << g_acc_decision_time
+                       << " sims/s=" << (g_acc_decision_time > 0 ? g_acc_simulator_calls / g_acc_decision_time : 0)
+                       << " nodes/s=" << (g_acc_decision_time > 0 ? g_acc_generated / g_acc_decision_time : 0)
+                       << " latency-p50=" << double(Profiler::decision_latency().quantile(0.50)) / 1e9
+                       << " latency-p90=" << double(Profiler::decision_latency().quantile(0.90)) / 1e9
+                       << " latency-p99=" << double(Profiler::decision_latency().quantile(0.99)) / 1e9
+                       << " latency-max=" << double(Profiler::decision_latency().max()) / 1e9
+                       << " peak-rss-kb=" << Utils::peak_rss_in_kb();
+            Logger::Stats << bench_line.str() << endl;
+            if( bench_output_stream != nullptr )
+                *bench_output_stream << bench_line.str() << endl;
+
+            map<string, string> result;
+            parse_bench_line(bench_line.str(), result);
+            if( bench_baseline.count(result["rom"]) > 0 )
+                bench_regressions += compare_with_bench_baseline(result, bench_baseline[result["rom"]], opt_bench_tolerance);
+            else if( opt_bench_baseline != "" )
+                Logger::Warning << "bench: rom=" << result["rom"] << " not in baseline" << endl;
         }
-    }
-    assert(planner != nullptr);
-    Logger::Info << "planner=" << planner->name() << endl;
 
-    // set number of initial noops
-    assert(opt_initial_random_noops > 0);
-    int initial_noops = lrand48() % opt_initial_random_noops;
+        delete planner;
+    }
 
-    // play
-    for( int k = 0; k < opt_episodes; ++k ) {
-        vector<Action> prefix;
-        float start_time = Utils::read_time_in_seconds();
-        run_episode(env, *planner, initial_noops, opt_lookahead_caching, opt_prefix_length_to_execute, opt_execute_single_action, opt_frameskip, opt_max_execution_length_in_frames, prefix);
-        float elapsed_time = Utils::read_time_in_seconds() - start_time;
-        Logger::Stats
-          << "episode-stats:"
-          // rom and log files
-          << " rom=" << opt_rom
-          // planner
-          << " planner=" << opt_planner_str
-          // general options
-          << " debug-threshold=" << opt_debug_threshold
-          << " frameskip=" << opt_frameskip
-          << " seed=" << opt_random_seed
-          << " use-minimal-action-set=" << opt_use_minimal_action_set
-          // episodes and execution length
-          << " episodes=" << opt_episodes
-          << " max-execution-length=" << opt_max_execution_length_in_frames
-          // simulate previous execution
-          << " fixed-action-sequence=\"" << opt_fixed_action_sequence << "\""
-          // features
-          << " features=" << opt_screen_features
-          << " frames-background-image=" << opt_frames_for_background_image
-          // online execution
-          << " initial-noops=" << opt_initial_random_noops
-          << " execute-single-action=" << opt_execute_single_action
-          << " caching=" << opt_lookahead_caching
-          << " prefix-length-to-execute=" << opt_prefix_length_to_execute
-          << " simulator-budget=" << opt_simulator_budget
-          << " time-budget=" << opt_time_budget
-          // common options for planners
-          << " alpha=" << opt_alpha
-          << " discount=" << opt_discount
-          << " max-rep=" << opt_max_rep
-          << " nodes-threshold=" << opt_nodes_threshold
-          << " novelty-subtables=" << opt_novelty_subtables
-          << " random-actions=" << opt_random_actions
-          << " use-alpha-to-update-reward-for-death=" << opt_use_alpha_to_update_reward_for_death
-          // rollout planner
-          << " max-depth=" << opt_max_depth
-          // bfs planner
-          << " break-ties-using-rewards=" << opt_break_ties_using_rewards
-          // data
-          << " score=" << g_acc_reward
-          << " frames=" << g_acc_frames
-          << " decisions=" << g_acc_decisions
-          << " simulator-calls=" << g_acc_simulator_calls
-          << " max-simulator-calls=" << g_max_simulator_calls
-          << " total-time=" << elapsed_time
-          << " simulator-time=" << g_acc_simulator_time
-          << " sum-expanded=" << g_acc_expanded
-          << " sum-height=" << g_acc_height
-          << " random-decisions=" << g_acc_random_decisions
-          << endl;
+    if( opt_bench ) {
+        Logger::Stats << "bench: #roms=" << roms.size() << " #flagged=" << bench_regressions << endl;
+        if( bench_output_stream != nullptr ) {
+            bench_output_stream->close();
+            delete bench_output_stream;
+        }
     }
 
     // cleanup
-    delete planner;
-    if( &Logger::output_stream() != default_log_file ) {
-        static_cast<ofstream*>(&Logger::output_stream())->close();
+    close_log(async_log_writer, logger_output_stream);
+    if( stats_output_stream != nullptr ) {
+        stats_output_stream->close();
+        delete stats_output_stream;
     }
 
-    return 0;
+    return bench_regressions > 0 ? 1 : 0;
 }
 
@@ -5,10 +5,15 @@
 
 #include <algorithm>
 #include <cassert>
+#include <deque>
 #include <iostream>
+#include <limits>
+#include <stdint.h>
 #include <string>
 #include <vector>
 #include <ale_interface.hpp>
+#include "atom_set.h"
+#include "random.h"
 
 class Node;
 inline void remove_tree(Node *node);
@@ -28,13 +33,23 @@ class Node {
     int ale_lives_;                          // remaining ALE lives
 
     mutable ALEState *state_;                // state for this node
-    mutable std::vector<int> feature_atoms_; // features made true by this node
+    uint64_t ale_state_hash_;                // hash of state_ (0 = none), kept when state is dropped
+    mutable AtomSet feature_atoms_;          // features made true by this node
+    mutable uint64_t atoms_fingerprint_;     // hash of inputs of feature_atoms_ (0 = none)
     mutable int num_novel_features_;         // number of features this node makes novel
     mutable int frame_rep_;                  // frame counter for number identical feature atoms through ancestors
-
-    // structure
-    int num_children_;                       // number of children
-    Node *first_child_;                      // first child
+    uint64_t state_hash_;                    // hash of RAM and lives (0 = none)
+    bool duplicate_;                         // state found in transposition table (no atoms)
+    bool equivalent_;                        // reaches same state as a sibling (to be merged)
+    bool deferred_state_;                    // info from transition cache without state
+    uint32_t equivalent_actions_;            // bitmap of actions of siblings merged into this node
+
+    // structure: children are materialized (allocated) only when selected
+    // or simulated; until then they are represented by their action in
+    // pending_actions_, and have no info (reward and value are 0)
+    int num_children_;                       // number of children (materialized or not)
+    uint32_t pending_actions_;               // bitmap of actions of children not materialized
+    Node *first_child_;                      // first materialized child
     Node *sibling_;                          // right sibling of this node
     Node *parent_;                           // pointer to parent node
 
@@ -51,16 +66,53 @@ class Node {
         value_(0),
         ale_lives_(-1),
         state_(nullptr),
+        ale_state_hash_(0),
+        atoms_fingerprint_(0),
         num_novel_features_(0),
         frame_rep_(0),
+        state_hash_(0),
+        duplicate_(false),
+        equivalent_(false),
+        deferred_state_(false),
+        equivalent_actions_(0),
         num_children_(0),
+        pending_actions_(0),
         first_child_(nullptr),
         sibling_(nullptr),
         parent_(parent) {
     }
     ~Node() { delete state_; }
 
+    // forget info of leaf so that it is generated again
+    void reset_info() {
+        assert((num_children_ == 0) && (first_child_ == nullptr));
+        visited_ = false;
+        solved_ = false;
+        reward_ = 0;
+        path_reward_ = 0;
+        is_info_valid_ = 0;
+        terminal_ = false;
+        value_ = 0;
+        ale_lives_ = -1;
+        delete state_;
+        state_ = nullptr;
+        ale_state_hash_ = 0;
+        clear_feature_atoms();
+        num_novel_features_ = 0;
+        frame_rep_ = 0;
+        state_hash_ = 0;
+        duplicate_ = false;
+        equivalent_ = false;
+        deferred_state_ = false;
+    }
+
+    void clear_feature_atoms() const {
+        feature_atoms_.clear();
+        atoms_fingerprint_ = 0;
+    }
+
     void remove_children() {
+        pending_actions_ = 0;
         while( first_child_ != nullptr ) {
             Node *child = first_child_;
             first_child_ = first_child_->sibling_;
@@ -68,10 +120,14 @@ class Node {
         }
     }
 
+    static uint32_t action_bit(Action action) {
+        assert((0 <= int(action)) && (int(action) < 32));
+        return uint32_t(1) << int(action);
+    }
+
     void expand(Action action) {
-        Node *new_child = new Node(this, action, 1 + depth_);
-        new_child->sibling_ = first_child_;
-        first_child_ = new_child;
+        assert((pending_actions_ & action_bit(action)) == 0);
+        pending_actions_ |= action_bit(action);
         ++num_children_;
     }
     void expand(const ActionVect &actions, bool random_shuffle = true) {
@@ -82,6 +138,59 @@ class Node {
         assert(num_children_ == int(actions.size()));
     }
 
+    // allocate child for pending action
+    Node* materialize(Action action) {
+        assert((pending_actions_ & action_bit(action)) != 0);
+        pending_actions_ &= ~action_bit(action);
+        Node *new_child = new Node(this, action, 1 + depth_);
+        new_child->sibling_ = first_child_;
+        first_child_ = new_child;
+        return new_child;
+    }
+
+    // materialized child for action (nullptr if there is none)
+    Node* child(Action action) const {
+        for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
+            if( child->action_ == action )
+                return child;
+        }
+        return nullptr;
+    }
+    // true if action leads to a child, either its own or one it was merged into
+    bool has_child(Action action) const {
+        if( (pending_actions_ & action_bit(action)) != 0 ) return true;
+        for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
+            if( (child->action_ == action) || ((child->equivalent_actions_ & action_bit(action)) != 0) )
+                return true;
+        }
+        return false;
+    }
+
+    // remove (and delete) materialized child
+    void remove_child(Node *child) {
+        assert(child->parent_ == this);
+        Node **link = &first_child_;
+        while( *link != child ) {
+            assert(*link != nullptr);
+            link = &(*link)->sibling_;
+        }
+        *link = child->sibling_;
+        --num_children_;
+        remove_tree(child);
+    }
+
+    size_t num_pending_children() const {
+        return __builtin_popcount(pending_actions_);
+    }
+    // action of pending child of given index (in increasing order of actions)
+    Action pending_action(size_t index) const {
+        assert(index < num_pending_children());
+        uint32_t bits = pending_actions_;
+        for( ; index > 0; --index )
+            bits &= bits - 1;
+        return Action(__builtin_ctz(bits));
+    }
+
     void clear_cached_states() {
         if( is_info_valid_ == 2 ) {
             delete state_;
@@ -93,15 +202,18 @@ class Node {
     }
 
     Node* advance(Action action) {
-        assert((num_children_ > 0) && (first_child_ != nullptr));
+        assert(num_children_ > 0);
         assert((parent_ == nullptr) || (parent_->parent_ == nullptr));
         if( parent_ != nullptr ) {
             delete parent_;
             parent_ = nullptr;
         }
 
+        if( child(action) == nullptr ) materialize(action);
+        pending_actions_ = 0;
         Node *selected = nullptr;
-        for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
+        for( Node *child = first_child_, *next = nullptr; child != nullptr; child = next ) {
+            next = child->sibling_;
             if( child->action_ == action )
                 selected = child;
             else
@@ -148,19 +260,21 @@ class Node {
             solved_ = true;
             if( parent_ != nullptr ) {
                 assert(!parent_->solved_);
-                bool unsolved_siblings = false;
-                for( Node *child = parent_->first_child_; child != nullptr; child = child->sibling_ ) {
-                    if( !child->solved_ ) {
-                        unsolved_siblings = true;
-                        break;
-                    }
-                }
-                if( !unsolved_siblings )
+                if( !parent_->has_unsolved_children() )
                     parent_->solve_and_backpropagate_label();
             }
         }
     }
 
+    bool has_unsolved_children() const {
+        if( pending_actions_ != 0 ) return true;
+        for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
+            if( !child->solved_ )
+                return true;
+        }
+        return false;
+    }
+
     float qvalue(float discount) const {
         return reward_ + discount * value_;
     }
@@ -170,8 +284,7 @@ class Node {
 
         value_ = 0;
         if( num_children_ > 0 ) {
-            assert(first_child_ != nullptr);
-            float max_child_value = -std::numeric_limits<float>::infinity();
+            float max_child_value = pending_actions_ != 0 ? 0 : -std::numeric_limits<float>::infinity();
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
                 float child_value = child->qvalue(discount);
                 max_child_value = std::max(max_child_value, child_value);
@@ -189,8 +302,7 @@ class Node {
         assert((num_children_ == 0) || (is_info_valid_ != 0));
         value_ = 0;
         if( num_children_ > 0 ) {
-            assert(first_child_ != nullptr);
-            float max_child_value = -std::numeric_limits<float>::infinity();
+            float max_child_value = pending_actions_ != 0 ? 0 : -std::numeric_limits<float>::infinity();
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
                 child->backup_values(discount);
                 float child_value = child->qvalue(discount);
@@ -210,7 +322,7 @@ class Node {
             assert(index < branch.size());
             float value_along_branch = 0;
             const Action &action = branch[index];
-            float max_child_value = -std::numeric_limits<float>::infinity();
+            float max_child_value = pending_actions_ != 0 ? 0 : -std::numeric_limits<float>::infinity();
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
                 if( child->action_ == action )
                     value_along_branch = child->backup_values_along_branch(branch, discount, ++index);
@@ -221,20 +333,24 @@ class Node {
         }
     }
 
-    const Node *best_tip_node(float discount) const { // NOT USED
+    // if best tip is a pending child, its parent is returned
+    const Node *best_tip_node(float discount, Random::Engine &rng) const { // NOT USED
         if( num_children_ == 0 ) {
             return this;
         } else {
-            assert(first_child_ != nullptr);
             size_t num_best_children = 0;
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ )
                 num_best_children += child->qvalue(discount) == value_;
+            size_t num_best_materialized_children = num_best_children;
+            if( value_ == 0 ) num_best_children += num_pending_children();
             assert(num_best_children > 0);
-            size_t index_best_child = lrand48() % num_best_children;
+            size_t index_best_child = rng.uniform(num_best_children);
+            if( index_best_child >= num_best_materialized_children )
+                return this;
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
                 if( child->qvalue(discount) == value_ ) {
                     if( index_best_child == 0 )
-                        return child->best_tip_node(discount);
+                        return child->best_tip_node(discount, rng);
                     --index_best_child;
                 }
             }
@@ -242,19 +358,24 @@ class Node {
         }
     }
 
-    void best_branch(std::deque<Action> &branch, float discount) const {
+    void best_branch(std::deque<Action> &branch, float discount, Random::Engine &rng) const {
         if( num_children_ > 0 ) {
-            assert(first_child_ != nullptr);
             size_t num_best_children = 0;
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ )
                 num_best_children += child->qvalue(discount) == value_;
+            size_t num_best_materialized_children = num_best_children;
+            if( value_ == 0 ) num_best_children += num_pending_children();
             assert(num_best_children > 0);
-            size_t index_best_child = lrand48() % num_best_children;
+            size_t index_best_child = rng.uniform(num_best_children);
+            if( index_best_child >= num_best_materialized_children ) {
+                branch.push_back(pending_action(index_best_child - num_best_materialized_children));
+                return;
+            }
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
                 if( child->qvalue(discount) == value_ ) {
                     if( index_best_child == 0 ) {
                         branch.push_back(child->action_);
-                        child->best_branch(branch, discount);
+                        child->best_branch(branch, discount, rng);
                         break;
                     }
                     --index_best_child;
@@ -263,10 +384,9 @@ class Node {
         }
     }
 
-    void longest_zero_value_branch(float discount, std::deque<Action> &branch) const {
+    void longest_zero_value_branch(float discount, std::deque<Action> &branch, Random::Engine &rng) const {
         assert(value_ == 0);
         if( num_children_ > 0 ) {
-            assert(first_child_ != nullptr);
             size_t max_height = 0;
             size_t num_best_children = 0;
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
@@ -278,13 +398,19 @@ class Node {
                     ++num_best_children;
                 }
             }
+            size_t num_best_materialized_children = num_best_children;
+            if( max_height == 0 ) num_best_children += num_pending_children();
             assert(num_best_children > 0);
-            size_t index_best_child = lrand48() % num_best_children;
+            size_t index_best_child = rng.uniform(num_best_children);
+            if( index_best_child >= num_best_materialized_children ) {
+                branch.push_back(pending_action(index_best_child - num_best_materialized_children));
+                return;
+            }
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
                 if( (child->qvalue(discount) == 0) && (child->height_ == int(max_height)) ) {
                     if( index_best_child == 0 ) {
                         branch.push_back(child->action_);
-                        child->longest_zero_value_branch(discount, branch);
+                        child->longest_zero_value_branch(discount, branch, rng);
                         break;
                     }
                     --index_best_child;
@@ -297,14 +423,14 @@ class Node {
         if( num_children_ == 0 ) {
             return 1;
         } else {
-            assert(first_child_ != nullptr);
-            size_t n = 0;
+            size_t n = num_pending_children();
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ )
                 n += child->num_tip_nodes();
             return n;
         }
     }
 
+    // number of materialized nodes
     size_t num_nodes() const {
         size_t n = 1;
         for( Node *child = first_child_; child != nullptr; child = child->sibling_ )
@@ -315,7 +441,6 @@ class Node {
     int calculate_height() {
         height_ = 0;
         if( num_children_ > 0 ) {
-            assert(first_child_ != nullptr);
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
                 int child_height = child->calculate_height();
                 height_ = std::max(height_, child_height);
@@ -329,7 +454,7 @@ class Node {
         print(os);
         if( index < branch.size() ) {
             Action action = branch[index];
-            bool child_found = false;
+            bool child_found = (pending_actions_ & action_bit(action)) != 0;
             for( Node *child = first_child_; child != nullptr; child = child->sibling_ ) {
                 if( child->action_ == action ) {
                     child->print_branch(os, branch, ++index);
@@ -351,6 +476,7 @@ class Node {
            << ", path-reward=" << path_reward_
            << ", action=" << action_
            << ", depth=" << depth_
+           << ", pending=" << num_pending_children()
            << ", children=[";
         for( Node *child = first_child_; child != nullptr; child = child->sibling_ )
             os << child->value_ << " ";
@@ -366,8 +492,12 @@ class Node {
 };
 
 inline void remove_tree(Node *node) {
-    for( Node *child = node->first_child_; child != nullptr; child = child->sibling_ )
+    Node *child = node->first_child_;
+    while( child != nullptr ) {
+        Node *sibling = child->sibling_;
         remove_tree(child);
+        child = sibling;
+    }
     delete node;
 }
 
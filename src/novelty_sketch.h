@@ -0,0 +1,92 @@
+// (c) 2017 Blai Bonet
+
+#ifndef NOVELTY_SKETCH_H
+#define NOVELTY_SKETCH_H
+
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdint.h>
+#include <vector>
+
+#include "utils.h"
+
+// Approximate novelty table of fixed size: a count-min style sketch that
+// keeps, for each of its rows, the minimum depth of the atoms hashed into
+// each cell. The depth of an atom is estimated as the maximum of its
+// cells (over rows); collisions can only lower estimates, so the sketch
+// may prune nodes that are novel but never keeps a node that is not.
+// Novelty subtables share the sketch by hashing the subtable index along
+// with the atom, so memory is rows x width 16-bit entries regardless of
+// the number of subtables.
+
+class NoveltySketch {
+  public:
+    typedef uint16_t depth_t;
+
+    NoveltySketch(size_t width, size_t rows)
+      : width_(round_up_to_power_of_two(width)),
+        rows_(width == 0 ? 0 : std::max<size_t>(rows, 1)),
+        table_(width_ * rows_) {
+        clear();
+    }
+
+    bool enabled() const {
+        return !table_.empty();
+    }
+    size_t width() const {
+        return width_;
+    }
+    size_t rows() const {
+        return rows_;
+    }
+    size_t bytes() const {
+        return table_.capacity() * sizeof(depth_t);
+    }
+
+    // mark all atoms as unseen
+    void clear() {
+        table_.assign(table_.size(), std::numeric_limits<depth_t>::max());
+    }
+
+    // same contract as SimPlanner::check_and_update_novelty() for the
+    // subtable with given index
+    int check_and_update(int index, int depth, const std::vector<int> &feature_atoms, bool update, size_t &num_updated) {
+        assert(enabled() && (depth < std::numeric_limits<depth_t>::max()));
+        int max_entry = 0;
+        num_updated = 0;
+        for( size_t k = 0; k < feature_atoms.size(); ++k ) {
+            // the two 32-bit halves of the hash are used for double hashing
+            uint64_t h = Utils::mix64((uint64_t(uint32_t(index)) << 32) | uint32_t(feature_atoms[k]));
+            size_t h1 = h & 0xFFFFFFFF;
+            size_t h2 = (h >> 32) | 1;
+            int entry = 0;
+            for( size_t r = 0; r < rows_; ++r )
+                entry = std::max<int>(entry, table_[r * width_ + ((h1 + r * h2) & (width_ - 1))]);
+            max_entry = std::max(max_entry, entry);
+            if( update && (depth < entry) ) {
+                for( size_t r = 0; r < rows_; ++r ) {
+                    depth_t &cell = table_[r * width_ + ((h1 + r * h2) & (width_ - 1))];
+                    if( depth < cell ) cell = depth;
+                }
+                ++num_updated;
+            }
+        }
+        return max_entry;
+    }
+
+  private:
+    const size_t width_;                     // power of two (0 = disabled)
+    const size_t rows_;
+    std::vector<depth_t> table_;
+
+    static size_t round_up_to_power_of_two(size_t n) {
+        if( n == 0 ) return 0;
+        size_t p = 1;
+        while( p < n ) p <<= 1;
+        return p;
+    }
+};
+
+#endif
+
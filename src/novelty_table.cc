@@ -0,0 +1,48 @@
+// (c) 2017 Blai Bonet
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "novelty_table.h"
+
+bool PageMemory::huge_pages_ = false;
+
+size_t PageMemory::page_size() {
+    static size_t page_size = sysconf(_SC_PAGESIZE);
+    return page_size;
+}
+
+void* PageMemory::reserve(size_t bytes) {
+    void *ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if( ptr == MAP_FAILED ) return nullptr;
+#ifdef MADV_HUGEPAGE
+    if( huge_pages_ ) madvise(ptr, bytes, MADV_HUGEPAGE);
+#endif
+    return ptr;
+}
+
+void PageMemory::release(void *ptr, size_t bytes) {
+    if( ptr != nullptr ) munmap(ptr, bytes);
+}
+
+void PageMemory::resident_pages(const void *ptr, size_t bytes, std::vector<unsigned char> &pages) {
+    pages = std::vector<unsigned char>((bytes + page_size() - 1) / page_size(), 0);
+#ifdef __linux__
+    if( mincore(const_cast<void*>(ptr), bytes, &pages[0]) != 0 )
+#else
+    if( mincore(const_cast<void*>(ptr), bytes, reinterpret_cast<char*>(&pages[0])) != 0 )
+#endif
+        pages = std::vector<unsigned char>(pages.size(), 1); // unknown: assume resident
+    for( size_t p = 0; p < pages.size(); ++p )
+        pages[p] &= 1;
+}
+
+size_t PageMemory::resident_bytes(const void *ptr, size_t bytes) {
+    std::vector<unsigned char> pages;
+    resident_pages(ptr, bytes, pages);
+    size_t n = 0;
+    for( size_t p = 0; p < pages.size(); ++p )
+        n += pages[p];
+    return n * page_size();
+}
+
@@ -0,0 +1,171 @@
+// (c) 2017 Blai Bonet
+
+#ifndef NOVELTY_TABLE_H
+#define NOVELTY_TABLE_H
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+#include <vector>
+
+// Zero-filled memory from anonymous mappings reserved with MAP_NORESERVE.
+// Pages are backed only when first written, so a large table costs what
+// is actually touched. Optionally, mappings are advised to use transparent
+// huge pages, which cuts TLB misses on random accesses at the cost of
+// backing memory in 2MB units.
+
+class PageMemory {
+  public:
+    static void set_huge_pages(bool huge_pages) {
+        huge_pages_ = huge_pages;
+    }
+    static bool huge_pages() {
+        return huge_pages_;
+    }
+
+    static size_t page_size();
+    static void* reserve(size_t bytes);      // nullptr on failure
+    static void release(void *ptr, size_t bytes);
+
+    // residency of each page in range (1 if resident, 0 otherwise); pages
+    // that were read but never written map the shared zero page and count
+    // as resident
+    static void resident_pages(const void *ptr, size_t bytes, std::vector<unsigned char> &pages);
+    static size_t resident_bytes(const void *ptr, size_t bytes);
+
+  private:
+    static bool huge_pages_;
+};
+
+// Novelty table: for each atom, the min depth at which it has been seen,
+// with the largest value of T meaning unseen. Entries are stored
+// complemented so that the zero pages of a fresh mapping read as unseen
+// and no fill pass is needed. One entry of padding is reserved past the
+// end for the 32-bit gathers of the vectorized novelty scan.
+
+template<typename T>
+class NoveltyTable {
+  public:
+    NoveltyTable(size_t num_atoms)
+      : num_atoms_(num_atoms),
+        bytes_(round_up_to_pages((num_atoms + 1) * sizeof(T))),
+        entries_(static_cast<T*>(PageMemory::reserve(bytes_))) {
+        if( entries_ == nullptr ) throw std::bad_alloc();
+    }
+    ~NoveltyTable() {
+        PageMemory::release(entries_, bytes_);
+    }
+    NoveltyTable(const NoveltyTable&) = delete;
+    NoveltyTable& operator=(const NoveltyTable&) = delete;
+
+    static int decode(T entry) {
+        return T(~entry);
+    }
+    static T encode(int depth) {
+        return T(~T(depth));
+    }
+
+    size_t size() const {
+        return num_atoms_;
+    }
+    size_t reserved_bytes() const {
+        return bytes_;
+    }
+    size_t resident_bytes() const {
+        return PageMemory::resident_bytes(entries_, bytes_);
+    }
+    T* data() {
+        return entries_;
+    }
+    const T* data() const {
+        return entries_;
+    }
+
+    int depth(int atom) const {
+        assert((atom >= 0) && (atom < int(num_atoms_)));
+        return decode(entries_[atom]);
+    }
+    void set_depth(int atom, int depth) {
+        assert((atom >= 0) && (atom < int(num_atoms_)));
+        entries_[atom] = encode(depth);
+    }
+
+    // number of seen atoms; pages that were never touched are skipped
+    size_t num_entries() const {
+        std::vector<unsigned char> pages;
+        PageMemory::resident_pages(entries_, bytes_, pages);
+        size_t entries_per_page = PageMemory::page_size() / sizeof(T);
+        size_t n = 0;
+        for( size_t p = 0; p < pages.size(); ++p ) {
+            if( pages[p] == 0 ) continue;
+            size_t end = std::min((p + 1) * entries_per_page, num_atoms_);
+            for( size_t k = p * entries_per_page; k < end; ++k )
+                n += entries_[k] != 0;
+        }
+        return n;
+    }
+
+  private:
+    const size_t num_atoms_;
+    const size_t bytes_;
+    T *entries_;
+
+    static size_t round_up_to_pages(size_t bytes) {
+        size_t page_size = PageMemory::page_size();
+        return (bytes + page_size - 1) / page_size * page_size;
+    }
+};
+
+// Novelty subtables indexed by logscore of path reward. The logscore of a
+// float lies in [-149,128], so subtables are found through a flat array
+// of pointers; indices holds the indices of existing subtables in order.
+
+template<typename T>
+class NoveltyTables {
+  public:
+    static const int min_index_ = -160;
+    static const int max_index_ = 160;
+
+    NoveltyTables() : tables_(max_index_ - min_index_, nullptr) { }
+    ~NoveltyTables() {
+        clear();
+    }
+    NoveltyTables(const NoveltyTables&) = delete;
+    NoveltyTables& operator=(const NoveltyTables&) = delete;
+
+    NoveltyTable<T>* find(int index) const {
+        assert((min_index_ <= index) && (index < max_index_));
+        return tables_[index - min_index_];
+    }
+    NoveltyTable<T>& insert(int index, size_t num_atoms) {
+        assert(find(index) == nullptr);
+        NoveltyTable<T> *table = new NoveltyTable<T>(num_atoms);
+        tables_[index - min_index_] = table;
+        indices_.insert(std::lower_bound(indices_.begin(), indices_.end(), index), index);
+        return *table;
+    }
+    const NoveltyTable<T>& at(int index) const {
+        assert(find(index) != nullptr);
+        return *find(index);
+    }
+    const std::vector<int>& indices() const {
+        return indices_;
+    }
+    bool empty() const {
+        return indices_.empty();
+    }
+    void clear() {
+        for( size_t k = 0; k < indices_.size(); ++k ) {
+            delete tables_[indices_[k] - min_index_];
+            tables_[indices_[k] - min_index_] = nullptr;
+        }
+        indices_.clear();
+    }
+
+  private:
+    std::vector<NoveltyTable<T>*> tables_;
+    std::vector<int> indices_;
+};
+
+#endif
+
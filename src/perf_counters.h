@@ -0,0 +1,130 @@
+// (c) 2017 Blai Bonet
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cerrno>
+#include <cstring>
+#include <stdint.h>
+#include <string>
+
+#ifdef __linux__
+  #include <linux/perf_event.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <unistd.h>
+#endif
+
+// Hardware performance counters (cycles, instructions, cache misses, and
+// branch misses) for the calling thread, read with perf_event_open(2) as a
+// single group so that all counters cover the same interval. Only user
+// space is counted, which is allowed with the default perf_event_paranoid
+// setting. Counters that the machine (or virtual machine) does not support
+// read as zero and are flagged as unavailable; if no counter can be
+// opened, open() fails and reports the reason.
+
+class PerfCounters {
+  public:
+    enum counter_t {
+      Cycles = 0,
+      Instructions = 1,
+      CacheMisses = 2,
+      BranchMisses = 3,
+      NumCounters = 4
+    };
+
+    static const char* counter_name(counter_t counter) {
+        static const char *names[] = { "cycles", "instructions", "cache-misses", "branch-misses" };
+        return names[counter];
+    }
+
+    PerfCounters() : leader_fd_(-1), num_open_(0) {
+        for( int k = 0; k < NumCounters; ++k ) {
+            fd_[k] = -1;
+            index_[k] = -1;
+        }
+    }
+    ~PerfCounters() {
+        close();
+    }
+
+    bool is_open() const {
+        return leader_fd_ >= 0;
+    }
+    bool available(counter_t counter) const {
+        return index_[counter] >= 0;
+    }
+    const std::string& error() const {
+        return error_;
+    }
+
+    bool open() {
+#ifdef __linux__
+        if( is_open() ) return true;
+        const uint64_t config[] = {
+          PERF_COUNT_HW_CPU_CYCLES,
+          PERF_COUNT_HW_INSTRUCTIONS,
+          PERF_COUNT_HW_CACHE_MISSES,
+          PERF_COUNT_HW_BRANCH_MISSES
+        };
+        for( int k = 0; k < NumCounters; ++k ) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = config[k];
+            attr.disabled = leader_fd_ < 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leader_fd_, 0);
+            if( fd < 0 ) {
+                if( error_.empty() ) error_ = std::string(counter_name(counter_t(k))) + ": " + strerror(errno);
+                continue;
+            }
+            fd_[k] = fd;
+            index_[k] = num_open_++;
+            if( leader_fd_ < 0 ) leader_fd_ = fd;
+        }
+        if( leader_fd_ < 0 ) return false;
+        ioctl(leader_fd_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_fd_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+#else
+        error_ = "perf_event_open not supported on this platform";
+        return false;
+#endif
+    }
+
+    void close() {
+#ifdef __linux__
+        for( int k = 0; k < NumCounters; ++k ) {
+            if( fd_[k] >= 0 ) ::close(fd_[k]);
+            fd_[k] = -1;
+            index_[k] = -1;
+        }
+#endif
+        leader_fd_ = -1;
+        num_open_ = 0;
+    }
+
+    // read current values (zero for unavailable counters)
+    void read(uint64_t values[NumCounters]) const {
+        uint64_t buffer[1 + NumCounters] = { 0 };
+#ifdef __linux__
+        if( is_open() && (::read(leader_fd_, buffer, sizeof(buffer)) < 0) ) buffer[0] = 0;
+#endif
+        for( int k = 0; k < NumCounters; ++k )
+            values[k] = (index_[k] >= 0) && (index_[k] < int(buffer[0])) ? buffer[1 + index_[k]] : 0;
+    }
+
+  private:
+    int leader_fd_;
+    int fd_[NumCounters];
+    int index_[NumCounters]; // position of counter in group read, -1 if unavailable
+    int num_open_;
+    std::string error_;
+};
+
+#endif
+
@@ -8,16 +8,25 @@
 #include <vector>
 #include <ale_interface.hpp>
 #include "node.h"
+#include "random.h"
 
 struct Planner {
+    mutable Random::Engine rng_;             // stream for all random choices made by planner
+
     Planner() { }
     virtual ~Planner() { }
+
+    void set_random_stream(const Random::Engine &rng) const {
+        rng_ = rng;
+    }
+
     virtual std::string name() const = 0;
     virtual float simulator_time() const = 0;
     virtual size_t simulator_calls() const = 0;
     virtual bool random_decision() const = 0;
     virtual size_t height() const = 0;
     virtual size_t expanded() const = 0;
+    virtual size_t generated() const = 0;
     virtual Action random_action() const = 0;
     virtual Node* get_branch(ALEInterface &env,
                              const std::vector<Action> &prefix,
@@ -60,9 +69,12 @@ struct RandomPlanner : Planner {
     virtual size_t expanded() const {
         return 0;
     }
+    virtual size_t generated() const {
+        return 0;
+    }
 
     virtual Action random_action() const {
-        return action_set_[lrand48() % action_set_size_];
+        return action_set_[rng_.uniform(action_set_size_)];
     }
 
     virtual Node* get_branch(ALEInterface &env,
@@ -109,6 +121,9 @@ struct FixedPlanner : public Planner {
     virtual size_t expanded() const {
         return 0;
     }
+    virtual size_t generated() const {
+        return 0;
+    }
 
     virtual Action random_action() const {
         assert(!actions_.empty());
@@ -0,0 +1,11 @@
+// (c) 2017 Blai Bonet
+
+#include "profiler.h"
+
+bool Profiler::enabled_ = false;
+bool Profiler::counters_enabled_ = false;
+thread_local PerfCounters Profiler::counters_;
+thread_local std::vector<Profiler::node_t> Profiler::nodes_;
+thread_local int Profiler::current_ = -1;
+thread_local Profiler::Histogram Profiler::decision_latency_;
+
@@ -0,0 +1,354 @@
+// (c) 2017 Blai Bonet
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "logger.h"
+#include "perf_counters.h"
+#include "stats.h"
+
+// Hierarchical phase profiler. Code is instrumented with scoped timers
+//
+//   Profiler::Scope scope(Profiler::Simulate);
+//
+// that accumulate time and calls along the current call path, so the same
+// phase is reported separately under different parents (e.g. get-atoms
+// under search vs. under branch selection). Time is read from the monotonic
+// clock only when profiling is enabled; otherwise a scope costs one branch.
+// Optionally, hardware counters (see PerfCounters) are read at the same
+// points and attributed to the phases like time; each read is a system
+// call, so counters are meant for attribution rather than timing. State
+// is per thread.
+
+class Profiler {
+  public:
+    enum phase_t {
+      Decision = 0,
+      Search = 1,
+      Simulate = 2,
+      ResetGame = 3,
+      CloneState = 4,
+      RestoreState = 5,
+      GetAtoms = 6,
+      RamAtoms = 7,
+      BasicFeatures = 8,
+      BprosFeatures = 9,
+      BprotFeatures = 10,
+      NoveltyCheck = 11,
+      NoveltyUpdate = 12,
+      Expand = 13,
+      Backup = 14,
+      BranchSelection = 15,
+      ScreenHash = 16,
+      NumPhases = 17
+    };
+
+    static const char* phase_name(phase_t phase) {
+        static const char *names[] = {
+          "decision", "search", "simulate", "reset", "clone-state", "restore-state",
+          "get-atoms", "ram-atoms", "basic-features", "bpros-features", "bprot-features",
+          "novelty-check", "novelty-update", "expand", "backup", "branch-selection",
+          "screen-hash"
+        };
+        assert((phase >= 0) && (phase < NumPhases));
+        return names[phase];
+    }
+
+    // Log-linear histogram with 8 sub-buckets per power of two, so that
+    // reported quantiles are within 12.5% of the true value.
+    class Histogram {
+      public:
+        Histogram() : counts_(num_buckets_, 0), count_(0), max_(0) { }
+
+        void record(uint64_t value) {
+            ++counts_[bucket(value)];
+            ++count_;
+            max_ = value > max_ ? value : max_;
+        }
+        void clear() {
+            counts_.assign(num_buckets_, 0);
+            count_ = 0;
+            max_ = 0;
+        }
+
+        uint64_t count() const {
+            return count_;
+        }
+        uint64_t max() const {
+            return max_;
+        }
+        uint64_t quantile(double q) const {
+            if( count_ == 0 ) return 0;
+            uint64_t rank = uint64_t(q * (count_ - 1)) + 1;
+            uint64_t cumulative = 0;
+            for( size_t k = 0; k < num_buckets_; ++k ) {
+                cumulative += counts_[k];
+                if( cumulative >= rank ) {
+                    uint64_t value = midpoint(k);
+                    return value < max_ ? value : max_;
+                }
+            }
+            return max_;
+        }
+
+      private:
+        static const size_t num_buckets_ = 8 * 63;
+        std::vector<uint64_t> counts_;
+        uint64_t count_;
+        uint64_t max_;
+
+        static size_t bucket(uint64_t value) {
+            if( value < 8 ) return value;
+            int e = 63 - __builtin_clzll(value);
+            return (e - 2) * 8 + ((value >> (e - 3)) & 7);
+        }
+        static uint64_t midpoint(size_t index) {
+            if( index < 8 ) return index;
+            int e = int(index / 8) + 2;
+            uint64_t lower = (uint64_t(8 + index % 8)) << (e - 3);
+            return lower + ((uint64_t(1) << (e - 3)) >> 1);
+        }
+    };
+
+    class Scope {
+      public:
+        explicit Scope(phase_t phase) : node_(-1), start_(0) {
+            if( Profiler::enabled_ ) {
+                node_ = Profiler::enter(phase);
+                if( Profiler::counters_enabled_ ) counters_.read(start_counters_);
+                start_ = Profiler::now();
+            }
+        }
+        ~Scope() {
+            stop();
+        }
+
+        // end phase before scope ends
+        void stop() {
+            if( node_ >= 0 ) {
+                uint64_t elapsed = Profiler::now() - start_;
+                if( Profiler::counters_enabled_ ) {
+                    uint64_t counters[PerfCounters::NumCounters];
+                    counters_.read(counters);
+                    for( int k = 0; k < PerfCounters::NumCounters; ++k )
+                        counters[k] -= start_counters_[k];
+                    Profiler::exit(node_, elapsed, counters);
+                } else {
+                    Profiler::exit(node_, elapsed, nullptr);
+                }
+                node_ = -1;
+            }
+        }
+
+      private:
+        int node_;
+        uint64_t start_;
+        uint64_t start_counters_[PerfCounters::NumCounters];
+    };
+
+  public:
+    static void set_enabled(bool enabled) {
+        Profiler::enabled_ = enabled;
+    }
+    static bool enabled() {
+        return Profiler::enabled_;
+    }
+
+    // open hardware counters for calling thread; on failure, profiling
+    // continues without counters and the reason is returned in error
+    static bool set_counters_enabled(bool enabled, std::string &error) {
+        Profiler::counters_enabled_ = false;
+        if( !enabled ) {
+            counters_.close();
+            return true;
+        }
+        if( !counters_.open() ) {
+            error = counters_.error();
+            return false;
+        }
+        Profiler::counters_enabled_ = true;
+        return true;
+    }
+    static bool counters_enabled() {
+        return Profiler::counters_enabled_;
+    }
+
+    // clear per-decision counters (cumulative counters are kept)
+    static void begin_decision() {
+        for( size_t k = 0; k < nodes_.size(); ++k ) {
+            nodes_[k].decision_calls_ = 0;
+            nodes_[k].decision_time_ = 0;
+            for( int j = 0; j < PerfCounters::NumCounters; ++j )
+                nodes_[k].decision_counters_[j] = 0;
+        }
+    }
+
+    // clear all counters
+    static void reset() {
+        nodes_.clear();
+        current_ = -1;
+        decision_latency_.clear();
+    }
+
+    // decision latencies are recorded by the caller of the planner (also
+    // when the profiler is disabled, for benchmarks)
+    static void record_decision_latency(uint64_t elapsed) {
+        decision_latency_.record(elapsed);
+    }
+    static const Histogram& decision_latency() {
+        return decision_latency_;
+    }
+
+    // per-decision profile, as a JSON object mapping phase paths to calls and time
+    static void add_stats(StatsSink::Record &record) {
+        if( !Profiler::enabled_ ) return;
+        std::string json = "{";
+        for( size_t k = 1; k < nodes_.size(); ++k ) {
+            if( nodes_[k].decision_calls_ == 0 ) continue;
+            if( json.size() > 1 ) json += ",";
+            std::ostringstream oss;
+            oss << std::setprecision(9) << double(nodes_[k].decision_time_) / 1e9;
+            json += "\"" + path(k) + "\":{\"calls\":" + std::to_string(nodes_[k].decision_calls_) + ",\"time\":" + oss.str();
+            for( int j = 0; Profiler::counters_enabled_ && (j < PerfCounters::NumCounters); ++j ) {
+                if( counters_.available(PerfCounters::counter_t(j)) )
+                    json += ",\"" + std::string(PerfCounters::counter_name(PerfCounters::counter_t(j))) + "\":" + std::to_string(nodes_[k].decision_counters_[j]);
+            }
+            json += "}";
+        }
+        json += "}";
+        record.add_json("profile", json);
+    }
+
+    // decision latency quantiles (in seconds)
+    static void add_latency_stats(StatsSink::Record &record) {
+        if( !Profiler::enabled_ ) return;
+        record.add("decision-latency-p50", double(decision_latency_.quantile(0.50)) / 1e9)
+          .add("decision-latency-p99", double(decision_latency_.quantile(0.99)) / 1e9)
+          .add("decision-latency-max", double(decision_latency_.max()) / 1e9);
+    }
+
+    // cumulative profile as indented tree, and decision latency quantiles
+    static void print(Logger::mode_t logger_mode) {
+        if( !Profiler::enabled_ || nodes_.empty() ) return;
+        logger_mode << "profile:"
+                    << " #decisions=" << decision_latency_.count()
+                    << " decision-latency=[p50=" << double(decision_latency_.quantile(0.50)) / 1e9
+                    << ",p99=" << double(decision_latency_.quantile(0.99)) / 1e9
+                    << ",max=" << double(decision_latency_.max()) / 1e9
+                    << "]" << std::endl;
+        print(logger_mode, 0, 0);
+    }
+
+  protected:
+    struct node_t {
+        phase_t phase_;
+        int parent_;
+        int children_[NumPhases];
+        uint64_t decision_calls_;
+        uint64_t decision_time_;
+        uint64_t total_calls_;
+        uint64_t total_time_;
+        uint64_t decision_counters_[PerfCounters::NumCounters];
+        uint64_t total_counters_[PerfCounters::NumCounters];
+        node_t(phase_t phase, int parent)
+          : phase_(phase),
+            parent_(parent),
+            decision_calls_(0),
+            decision_time_(0),
+            total_calls_(0),
+            total_time_(0) {
+            for( int k = 0; k < NumPhases; ++k )
+                children_[k] = -1;
+            for( int k = 0; k < PerfCounters::NumCounters; ++k ) {
+                decision_counters_[k] = 0;
+                total_counters_[k] = 0;
+            }
+        }
+    };
+
+    static bool enabled_;
+    static bool counters_enabled_;
+    static thread_local PerfCounters counters_;
+    static thread_local std::vector<node_t> nodes_;
+    static thread_local int current_;
+    static thread_local Histogram decision_latency_;
+
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static int enter(phase_t phase) {
+        if( nodes_.empty() ) {
+            nodes_.push_back(node_t(Decision, -1)); // root of call tree (not a phase)
+            current_ = 0;
+        }
+        int child = nodes_[current_].children_[phase];
+        if( child < 0 ) {
+            child = nodes_.size();
+            nodes_.push_back(node_t(phase, current_));
+            nodes_[current_].children_[phase] = child;
+        }
+        current_ = child;
+        return child;
+    }
+
+    static void exit(int node, uint64_t elapsed, const uint64_t *counters) {
+        assert(node == current_);
+        node_t &n = nodes_[node];
+        ++n.decision_calls_;
+        n.decision_time_ += elapsed;
+        ++n.total_calls_;
+        n.total_time_ += elapsed;
+        for( int k = 0; (counters != nullptr) && (k < PerfCounters::NumCounters); ++k ) {
+            n.decision_counters_[k] += counters[k];
+            n.total_counters_[k] += counters[k];
+        }
+        current_ = n.parent_;
+    }
+
+    static std::string path(int node) {
+        std::string p = phase_name(nodes_[node].phase_);
+        for( int n = nodes_[node].parent_; n > 0; n = nodes_[n].parent_ )
+            p = std::string(phase_name(nodes_[n].phase_)) + "/" + p;
+        return p;
+    }
+
+    static void print(Logger::mode_t logger_mode, int node, int indent) {
+        uint64_t children_time = 0;
+        for( int k = 0; k < NumPhases; ++k ) {
+            if( nodes_[node].children_[k] >= 0 )
+                children_time += nodes_[nodes_[node].children_[k]].total_time_;
+        }
+        if( node > 0 ) {
+            const node_t &n = nodes_[node];
+            logger_mode << "profile: "
+                        << std::string(2 * indent, ' ') << phase_name(n.phase_)
+                        << " calls=" << n.total_calls_
+                        << " time=" << double(n.total_time_) / 1e9
+                        << " self-time=" << double(n.total_time_ - std::min(n.total_time_, children_time)) / 1e9
+                        << " avg=" << (n.total_calls_ == 0 ? 0 : double(n.total_time_) / n.total_calls_ / 1e9);
+            for( int k = 0; Profiler::counters_enabled_ && (k < PerfCounters::NumCounters); ++k ) {
+                if( counters_.available(PerfCounters::counter_t(k)) )
+                    Logger::Continuation(logger_mode) << " " << PerfCounters::counter_name(PerfCounters::counter_t(k)) << "=" << n.total_counters_[k];
+            }
+            if( Profiler::counters_enabled_ && (n.total_counters_[PerfCounters::Cycles] > 0) )
+                Logger::Continuation(logger_mode) << " ipc=" << double(n.total_counters_[PerfCounters::Instructions]) / n.total_counters_[PerfCounters::Cycles];
+            Logger::Continuation(logger_mode) << std::endl;
+        }
+        for( int k = 0; k < NumPhases; ++k ) {
+            if( nodes_[node].children_[k] >= 0 )
+                print(logger_mode, nodes_[node].children_[k], node > 0 ? indent + 1 : indent);
+        }
+    }
+};
+
+#endif
+
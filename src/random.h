@@ -0,0 +1,91 @@
+// (c) 2017 Blai Bonet
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cassert>
+#include <limits>
+#include <stdint.h>
+
+// Planner-owned pseudo-random numbers. Each planner (and each thread or
+// episode) owns its own engine so that random choices do not depend on
+// global state such as lrand48(), and runs are reproducible from --seed.
+
+namespace Random {
+
+// splitmix64: used to expand seeds into engine states and to derive streams
+inline uint64_t splitmix64(uint64_t &x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256** (Blackman and Vigna, 2018)
+class Engine {
+  public:
+    typedef uint64_t result_type;
+
+    explicit Engine(uint64_t seed = 0) {
+        set_seed(seed);
+    }
+
+    void set_seed(uint64_t seed) {
+        uint64_t x = seed;
+        for( int k = 0; k < 4; ++k )
+            s_[k] = splitmix64(x);
+    }
+
+    static constexpr result_type min() {
+        return 0;
+    }
+    static constexpr result_type max() {
+        return std::numeric_limits<result_type>::max();
+    }
+
+    result_type operator()() {
+        const uint64_t result = rotl(s_[1] * 5, 7) * 9;
+        const uint64_t t = s_[1] << 17;
+        s_[2] ^= s_[0];
+        s_[3] ^= s_[1];
+        s_[1] ^= s_[2];
+        s_[0] ^= s_[3];
+        s_[2] ^= t;
+        s_[3] = rotl(s_[3], 45);
+        return result;
+    }
+
+    // uniform integer in [0, n) using multiply-shift (no division)
+    size_t uniform(size_t n) {
+        assert(n > 0);
+        return size_t((static_cast<unsigned __int128>((*this)()) * n) >> 64);
+    }
+
+    // uniform real in [0, 1)
+    double uniform01() {
+        return double((*this)() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+  private:
+    uint64_t s_[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+// Independent stream for given seed, episode and thread. Distinct triplets
+// produce unrelated engine states, so parallel runs remain reproducible.
+inline Engine stream(uint64_t seed, uint64_t episode, uint64_t thread = 0) {
+    uint64_t x = seed;
+    uint64_t h = splitmix64(x);
+    x = h ^ (0x632be59bd9b4e019ULL + episode);
+    h = splitmix64(x);
+    x = h ^ (0x8cb92ba72f3d8dd7ULL + thread);
+    return Engine(splitmix64(x));
+}
+
+};
+
+#endif
+
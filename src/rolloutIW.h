@@ -4,15 +4,18 @@
 #define ROLLOUT_IW_H
 
 #include <cassert>
-#include <map>
 #include <string>
 #include <vector>
 
 #include "sim_planner.h"
 #include "logger.h"
+#include "profiler.h"
 
+// F is the feature-mode policy (see features.h)
+template<typename F>
 struct RolloutIW : SimPlanner {
-    const int screen_features_;
+    typedef NoveltyTables<typename F::depth_t> novelty_tables_t;
+
     const float time_budget_;
     const bool novelty_subtables_;
     const bool random_actions_;
@@ -34,11 +37,20 @@ struct RolloutIW : SimPlanner {
     RolloutIW(ALEInterface &sim,
               size_t frameskip,
               bool use_minimal_action_set,
-              size_t num_tracked_atoms,
-              int screen_features,
               int simulator_budget,
               float time_budget,
+              size_t memory_budget,
               bool novelty_subtables,
+              size_t sketch_width,
+              size_t sketch_rows,
+              bool sketch_verify,
+              size_t feature_cache_size,
+              bool transpositions,
+              size_t transition_cache_size,
+              bool transition_cache_states,
+              bool action_equivalence,
+              bool warm_start_novelty,
+              bool warm_start_verify,
               bool random_actions,
               size_t max_rep,
               float discount,
@@ -46,8 +58,7 @@ struct RolloutIW : SimPlanner {
               bool use_alpha_to_update_reward_for_death,
               int nodes_threshold,
               size_t max_depth)
-      : SimPlanner(sim, frameskip, use_minimal_action_set, simulator_budget, num_tracked_atoms),
-        screen_features_(screen_features),
+      : SimPlanner(sim, frameskip, use_minimal_action_set, simulator_budget, F::num_atoms_, memory_budget, sketch_width, sketch_rows, sketch_verify, feature_cache_size, transpositions, transition_cache_size, transition_cache_states, action_equivalence, warm_start_novelty, warm_start_verify),
         time_budget_(time_budget),
         novelty_subtables_(novelty_subtables),
         random_actions_(random_actions),
@@ -64,10 +75,17 @@ struct RolloutIW : SimPlanner {
         return std::string("rollout(")
           + "frameskip=" + std::to_string(frameskip_)
           + ",minimal-action-set=" + std::to_string(use_minimal_action_set_)
-          + ",features=" + std::to_string(screen_features_)
+          + ",features=" + std::to_string(F::type_)
           + ",simulator-budget=" + std::to_string(simulator_budget_)
           + ",time-budget=" + std::to_string(time_budget_)
+          + ",memory-budget=" + std::to_string(memory_budget_)
           + ",novelty-subtables=" + std::to_string(novelty_subtables_)
+          + ",novelty-sketch=" + std::to_string(sketch_.rows()) + "x" + std::to_string(sketch_.width())
+          + ",feature-cache=" + std::to_string(feature_cache_.capacity())
+          + ",transpositions=" + std::to_string(use_transpositions_)
+          + ",transition-cache=" + std::to_string(transition_cache_.capacity())
+          + ",action-equivalence=" + std::to_string(use_action_equivalence_)
+          + ",warm-start-novelty=" + std::to_string(use_warm_start_novelty_)
           + ",random-actions=" + std::to_string(random_actions_)
           + ",max-rep=" + std::to_string(max_rep_)
           + ",discount=" + std::to_string(discount_)
@@ -99,18 +117,22 @@ struct RolloutIW : SimPlanner {
         Logger::Info << "prefix: sz=" << prefix.size() << ", actions=";
         print_prefix(Logger::Info, prefix);
         Logger::Continuation(Logger::Info) << std::endl;
-        Logger::Info << "input:"
-                     << " #nodes=" << (root == nullptr ? "na" : std::to_string(root->num_nodes()))
-                     << ", #tips=" << (root == nullptr ? "na" : std::to_string(root->num_tip_nodes()))
-                     << ", height=" << (root == nullptr ? "na" : std::to_string(root->height_))
-                     << std::endl;
+        LOGGER(Logger::Info) << "input:"
+                             << " #nodes=" << (root == nullptr ? "na" : std::to_string(root->num_nodes()))
+                             << ", #tips=" << (root == nullptr ? "na" : std::to_string(root->num_tip_nodes()))
+                             << ", height=" << (root == nullptr ? "na" : std::to_string(root->height_))
+                             << std::endl;
 
         // reset stats and start timer
         reset_stats();
         float start_time = Utils::read_time_in_seconds();
+        Profiler::begin_decision();
+        Profiler::Scope decision_scope(Profiler::Decision);
 
-        // novelty table and other vars
-        std::map<int, std::vector<int> > novelty_table_map;
+        // novelty table (and cold table to verify warm start) and other vars
+        novelty_tables_t novelty_table_map;
+        novelty_tables_t cold_table_map;
+        reset_novelty_sketch();
 
         // construct root node
         assert((root == nullptr) || (root->action_ == prefix.back()));
@@ -125,23 +147,18 @@ struct RolloutIW : SimPlanner {
 
         // if root has some children, make sure it has all children
         if( root->num_children_ > 0 ) {
-            assert(root->first_child_ != nullptr);
-            std::set<Action> root_actions;
-            for( Node *child = root->first_child_; child != nullptr; child = child->sibling_ )
-                root_actions.insert(child->action_);
-
             // complete children
             assert(root->num_children_ <= int(action_set_.size()));
             if( root->num_children_ < int(action_set_.size()) ) {
                 for( size_t k = 0; k < action_set_.size(); ++k ) {
-                    if( root_actions.find(action_set_[k]) == root_actions.end() )
+                    if( !root->has_child(action_set_[k]) )
                         root->expand(action_set_[k]);
                 }
             }
-            assert(root->num_children_ == int(action_set_.size()));
+            assert(root->num_children_ <= int(action_set_.size()));
         } else {
             // make sure this root node isn't marked as frame rep
-            root->parent_->feature_atoms_.clear();
+            root->parent_->clear_feature_atoms();
         }
 
         // normalize depths, reset rep counters, and recompute path rewards
@@ -149,6 +166,13 @@ struct RolloutIW : SimPlanner {
         root->normalize_depth();
         root->reset_frame_rep_counters(frameskip_);
         root->recompute_path_rewards(root);
+        reset_transpositions(root);
+        reset_deferred_states(root);
+        account_memory(root->parent_);
+
+        // novelty tables hold atoms of the kept nodes that rollouts would
+        // update them with (the root is never checked)
+        warm_start_novelty<F>(root, novelty_table_map, novelty_subtables_, 1, int(max_depth_), false);
 
         // construct/extend lookahead tree
         if( int(root->num_nodes()) < nodes_threshold_ ) {
@@ -157,55 +181,58 @@ struct RolloutIW : SimPlanner {
             // clear solved labels
             clear_solved_labels(root);
             root->parent_->solved_ = false;
-            Logger::Debug << "";
-            while( !root->solved_ && (int(simulator_calls_) < simulator_budget_) && (elapsed_time < time_budget_) ) {
-                Logger::Continuation(Logger::Debug) << '.' << std::flush;
-                rollout(prefix, root, novelty_table_map);
+            LOGGER(Logger::Debug) << "";
+            Profiler::Scope search_scope(Profiler::Search);
+            while( !root->solved_ && (int(simulator_calls_) < simulator_budget_) && (elapsed_time < time_budget_) && !memory_budget_exhausted() ) {
+                LOGGER(Logger::Continuation(Logger::Debug)) << '.' << std::flush;
+                rollout(prefix, root, novelty_table_map, warm_start_verify_ ? &cold_table_map : nullptr);
                 elapsed_time = Utils::read_time_in_seconds() - start_time;
             }
-            Logger::Continuation(Logger::Debug) << std::endl;
+            LOGGER(Logger::Continuation(Logger::Debug)) << std::endl;
         }
 
         // if nothing was expanded, return random actions (it can only happen with small time budget)
         if( root->num_children_ == 0 ) {
             assert(root->first_child_ == nullptr);
-            assert(time_budget_ != std::numeric_limits<float>::infinity());
+            assert((time_budget_ != std::numeric_limits<float>::infinity()) || memory_budget_hit_);
             random_decision_ = true;
             branch.push_back(random_action());
         } else {
-            assert(root->first_child_ != nullptr);
-
             // backup values and calculate heights
+            Profiler::Scope backup_scope(Profiler::Backup);
             root->backup_values(discount_);
             root->calculate_height();
             root_height_ = root->height_;
+            backup_scope.stop();
 
             // print info about root node
-            Logger::Debug << Logger::green()
-                          << "root:"
-                          << " solved=" << root->solved_
-                          << ", value=" << root->value_
-                          << ", imm-reward=" << root->reward_
-                          << ", children=[";
+            LOGGER(Logger::Debug) << Logger::green()
+                                  << "root:"
+                                  << " solved=" << root->solved_
+                                  << ", value=" << root->value_
+                                  << ", imm-reward=" << root->reward_
+                                  << ", children=[";
             for( Node *child = root->first_child_; child != nullptr; child = child->sibling_ )
-                Logger::Continuation(Logger::Debug) << child->qvalue(discount_) << ":" << child->action_ << " ";
-            Logger::Continuation(Logger::Debug) << "]" << Logger::normal() << std::endl;
+                LOGGER(Logger::Continuation(Logger::Debug)) << child->qvalue(discount_) << ":" << child->action_ << " ";
+            LOGGER(Logger::Continuation(Logger::Debug)) << "]" << Logger::normal() << std::endl;
 
             // compute branch
+            Profiler::Scope branch_scope(Profiler::BranchSelection);
             if( root->value_ != 0 ) {
-                root->best_branch(branch, discount_);
+                root->best_branch(branch, discount_, rng_);
             } else {
                 if( random_actions_ ) {
                     random_decision_ = true;
                     branch.push_back(random_zero_value_action(root, discount_));
                 } else {
-                    root->longest_zero_value_branch(discount_, branch);
+                    root->longest_zero_value_branch(discount_, branch, rng_);
                     assert(!branch.empty());
                 }
             }
 
             // make sure states along branch exist (only needed when doing partial caching)
-            generate_states_along_branch(root, branch, screen_features_, alpha_, use_alpha_to_update_reward_for_death_);
+            generate_states_along_branch<F>(root, branch, alpha_, use_alpha_to_update_reward_for_death_);
+            branch_scope.stop();
 
             // print branch
             assert(!branch.empty());
@@ -218,14 +245,16 @@ struct RolloutIW : SimPlanner {
         }
 
         // stop timer and print stats
+        decision_scope.stop();
         total_time_ = Utils::read_time_in_seconds() - start_time;
         print_stats(Logger::Stats, *root, novelty_table_map);
+        record_stats(*root, novelty_table_map);
 
         // return root node
         return root;
     }
 
-    void rollout(const std::vector<Action> &prefix, Node *root, std::map<int, std::vector<int> > &novelty_table_map) const {
+    void rollout(const std::vector<Action> &prefix, Node *root, novelty_tables_t &novelty_table_map, novelty_tables_t *cold_table_map) const {
         ++num_rollouts_;
 
         // apply prefix
@@ -233,12 +262,12 @@ struct RolloutIW : SimPlanner {
 
         // update root info
         if( root->is_info_valid_ != 2 )
-            update_info(root, screen_features_, alpha_, use_alpha_to_update_reward_for_death_);
+            update_info<F>(root, alpha_, use_alpha_to_update_reward_for_death_);
 
         // perform rollout
         Node *node = root;
         while( !node->solved_ ) {
-            assert(node->is_info_valid_ == 2);
+            assert(node->is_info_valid_ != 0);
 
             // if first time at this node, expand node
             expand_if_necessary(node);
@@ -249,13 +278,22 @@ struct RolloutIW : SimPlanner {
 
             // update info
             if( node->is_info_valid_ != 2 )
-                update_info(node, screen_features_, alpha_, use_alpha_to_update_reward_for_death_);
+                update_info<F>(node, alpha_, use_alpha_to_update_reward_for_death_);
+
+            // merge node into sibling that reaches same state, and terminate rollout
+            if( node->equivalent_ ) {
+                Node *parent = node->parent_;
+                merge_equivalent_child(node);
+                if( !parent->has_unsolved_children() )
+                    parent->solve_and_backpropagate_label();
+                break;
+            }
 
             // report non-zero rewards
             if( node->reward_ > 0 ) {
-                Logger::Continuation(Logger::Debug) << Logger::yellow() << "+" << Logger::normal() << std::flush;
+                LOGGER(Logger::Continuation(Logger::Debug)) << Logger::yellow() << "+" << Logger::normal() << std::flush;
             } else if( node->reward_ < 0 ) {
-                Logger::Continuation(Logger::Debug) << "-" << std::flush;
+                LOGGER(Logger::Continuation(Logger::Debug)) << "-" << std::flush;
             }
 
             // if terminal, label as solved and terminate rollout
@@ -267,23 +305,33 @@ struct RolloutIW : SimPlanner {
                 break;
             }
 
+            // prune duplicates of nodes in transposition table
+            if( node->duplicate_ ) {
+                node->visited_ = true;
+                assert((node->num_children_ == 0) && (node->first_child_ == nullptr));
+                node->solve_and_backpropagate_label();
+                break;
+            }
+
             // verify repetitions of feature atoms (screen mode)
-            if( node->frame_rep_ > int(max_rep_) ) {
+            if( F::screen_ && (node->frame_rep_ > int(max_rep_)) ) {
                 node->visited_ = true;
                 assert((node->num_children_ == 0) && (node->first_child_ == nullptr));
                 node->solve_and_backpropagate_label();
                 //logos_ << "R" << std::flush;
                 break;
-            } else if( node->frame_rep_ > 0 ) {
+            } else if( F::screen_ && (node->frame_rep_ > 0) ) {
                 node->visited_ = true;
                 //logos_ << "r" << std::flush;
                 continue;
             }
 
-            // calculate novelty
-            std::vector<int> &novelty_table = get_novelty_table(node, novelty_table_map, novelty_subtables_);
-            int atom = get_novel_atom(node->depth_, node->feature_atoms_, novelty_table);
-            assert((atom >= 0) && (atom < int(novelty_table.size())));
+            // calculate novelty, and update table for new novel nodes
+            size_t num_updated = 0;
+            bool update = !node->visited_ && (node->depth_ <= int(max_depth_));
+            int novelty = check_and_update_novelty<F>(node, novelty_table_map, novelty_subtables_, update, num_updated);
+            if( update && (cold_table_map != nullptr) )
+                check_warm_start_prune<F>(node, novelty, *cold_table_map, novelty_subtables_);
 
             // five cases
             if( node->depth_ > int(max_depth_) ) {
@@ -292,7 +340,7 @@ struct RolloutIW : SimPlanner {
                 node->solve_and_backpropagate_label();
                 //logos_ << "D" << std::flush;
                 break;
-            } else if( novelty_table[atom] > node->depth_ ) { // novel => not(visited)
+            } else if( novelty > node->depth_ ) { // novel => not(visited)
                 // when caching, the assertion
                 //
                 //   assert(!node->visited_);
@@ -303,27 +351,27 @@ struct RolloutIW : SimPlanner {
                 if( !node->visited_ ) {
                     ++num_cases_[0];
                     node->visited_ = true;
-                    node->num_novel_features_ = update_novelty_table(node->depth_, node->feature_atoms_, novelty_table);
+                    node->num_novel_features_ = num_updated;
                     //logos_ << Utils::green() << "n" << Utils::normal() << std::flush;
                 }
                 continue;
-            } else if( !node->visited_ && (novelty_table[atom] <= node->depth_) ) { // not(novel) and not(visited) => PRUNE
+            } else if( !node->visited_ && (novelty <= node->depth_) ) { // not(novel) and not(visited) => PRUNE
                 ++num_cases_[1];
                 node->visited_ = true;
                 assert((node->num_children_ == 0) && (node->first_child_ == nullptr));
                 node->solve_and_backpropagate_label();
                 //logos_ << "x" << node->depth_ << std::flush;
                 break;
-            } else if( node->visited_ && (novelty_table[atom] < node->depth_) ) { // not(novel) and visited => PRUNE
+            } else if( node->visited_ && (novelty < node->depth_) ) { // not(novel) and visited => PRUNE
                 ++num_cases_[2];
                 //node->remove_children();
                 node->reward_ = -std::numeric_limits<float>::infinity();
-                Logger::Continuation(Logger::Debug) << "-" << std::flush;
+                LOGGER(Logger::Continuation(Logger::Debug)) << "-" << std::flush;
                 node->solve_and_backpropagate_label();
                 //logos_ << "X" << node->depth_ << std::flush;
                 break;
             } else { // optimal and visited => CONTINUE
-                assert(node->visited_ && (novelty_table[atom] == node->depth_));
+                assert(node->visited_ && (novelty == node->depth_));
                 ++num_cases_[3];
                 //logos_ << "c" << std::flush;
                 continue;
@@ -334,25 +382,28 @@ struct RolloutIW : SimPlanner {
     void expand_if_necessary(Node *node) const {
         if( node->num_children_ == 0 ) {
             assert(node->first_child_ == nullptr);
-            if( node->frame_rep_ == 0 ) {
+            if( !F::screen_ || (node->frame_rep_ == 0) ) {
                 ++num_expansions_;
+                Profiler::Scope scope(Profiler::Expand);
                 float start_time = Utils::read_time_in_seconds();
                 node->expand(action_set_);
                 expand_time_ += Utils::read_time_in_seconds() - start_time;
             } else {
-                assert((node->parent_ != nullptr) && (screen_features_ > 0));
+                assert((node->parent_ != nullptr) && F::screen_);
                 node->expand(node->action_);
             }
-            assert((node->num_children_ > 0) && (node->first_child_ != nullptr));
+            assert((node->num_children_ > 0) && (node->first_child_ == nullptr));
         }
     }
 
-    Node* pick_unsolved_child(const Node *node) const {
+    // pending children are unsolved and have no novel features; the
+    // selected child is materialized if pending
+    Node* pick_unsolved_child(Node *node) const {
         Node *selected = nullptr;
 
         // decide to pick among all unsolved children or among those
         // with biggest number of novel features
-        bool filter_unsolved_children = false; //lrand48() % 2;
+        bool filter_unsolved_children = false; //rng_.uniform(2);
 
         // select unsolved child
         size_t num_candidates = 0;
@@ -366,8 +417,12 @@ struct RolloutIW : SimPlanner {
                 ++num_candidates;
             }
         }
+        size_t num_materialized_candidates = num_candidates;
+        if( novel_features_threshold <= 0 ) num_candidates += node->num_pending_children();
         assert(num_candidates > 0);
-        size_t index = lrand48() % num_candidates;
+        size_t index = rng_.uniform(num_candidates);
+        if( index >= num_materialized_candidates )
+            return materialize_child(node, node->pending_action(index - num_materialized_candidates));
         for( Node *child = node->first_child_; child != nullptr; child = child->sibling_ ) {
             if( !child->solved_ && (child->num_novel_features_ >= novel_features_threshold) ) {
                 if( index == 0 ) {
@@ -402,13 +457,16 @@ struct RolloutIW : SimPlanner {
         random_decision_ = false;
     }
 
-    void print_stats(Logger::mode_t logger_mode, const Node &root, const std::map<int, std::vector<int> > &novelty_table_map) const {
+    void print_stats(Logger::mode_t logger_mode, const Node &root, const novelty_tables_t &novelty_table_map) const {
+        if( !Logger::enabled(logger_mode) ) return;
         logger_mode << "decision-stats:"
                     << " #rollouts=" << num_rollouts_
                     << " #entries=[";
 
-        for( std::map<int, std::vector<int> >::const_iterator it = novelty_table_map.begin(); it != novelty_table_map.end(); ++it )
-            Logger::Continuation(logger_mode) << it->first << ":" << num_entries(it->second) << "/" << it->second.size() << ",";
+        for( size_t k = 0; k < novelty_table_map.indices().size(); ++k ) {
+            const NoveltyTable<typename F::depth_t> &novelty_table = novelty_table_map.at(novelty_table_map.indices()[k]);
+            Logger::Continuation(logger_mode) << novelty_table_map.indices()[k] << ":" << num_entries(novelty_table) << "/" << novelty_table.size() << ",";
+        }
 
         Logger::Continuation(logger_mode)
           << "]"
@@ -431,11 +489,48 @@ struct RolloutIW : SimPlanner {
           << " expand-time=" << expand_time_
           << " update-novelty-time=" << update_novelty_time_
           << " get-atoms-calls=" << get_atoms_calls_
+          << " derived-atoms-skipped=" << derived_atoms_skipped_
           << " get-atoms-time=" << get_atoms_time_
-          << " novel-atom-time=" << novel_atom_time_
-          << std::endl;
+          << " novel-atom-time=" << novel_atom_time_;
+        print_sketch_stats(logger_mode);
+        print_feature_cache_stats(logger_mode);
+        print_transposition_stats(logger_mode);
+        print_transition_cache_stats(logger_mode);
+        print_action_equivalence_stats(logger_mode);
+        print_warm_start_stats(logger_mode);
+        print_memory_stats(logger_mode, novelty_table_map);
+    }
+
+    void record_stats(const Node &root, const novelty_tables_t &novelty_table_map) const {
+        if( !StatsSink::available() ) return;
+        std::vector<int> child_heights;
+        for( Node *child = root.first_child_; child != nullptr; child = child->sibling_ )
+            child_heights.push_back(child->height_);
+        std::vector<size_t> cases(num_cases_, num_cases_ + 4);
+        StatsSink::Record record("decision");
+        record.add("planner", "rollout")
+          .add("rollouts", num_rollouts_);
+        add_novelty_stats(record, novelty_table_map);
+        record.add("nodes", root.num_nodes())
+          .add("tips", root.num_tip_nodes())
+          .add("height", root.height_)
+          .add("child-heights", child_heights)
+          .add("expansions", num_expansions_)
+          .add("cases", cases);
+        add_simulator_stats(record);
+        record.add("total-time", total_time_)
+          .add("expand-time", expand_time_);
+        add_atoms_stats(record);
+        add_sketch_stats(record);
+        add_feature_cache_stats(record);
+        add_transposition_stats(record);
+        add_transition_cache_stats(record);
+        add_action_equivalence_stats(record);
+        add_warm_start_stats(record);
+        add_memory_stats(record, novelty_table_map);
+        Profiler::add_stats(record);
+        StatsSink::write(record);
     }
 };
 
 #endif
-
@@ -6,11 +6,14 @@
 #include <cassert>
 #include <iostream>
 #include <map>
+#include <stdint.h>
 #include <string>
 #include <vector>
 #include <ale_interface.hpp>
 
 #include "logger.h"
+#include "profiler.h"
+#include "random.h"
 #include "utils.h"
 
 struct MyALEScreen {
@@ -38,10 +41,16 @@ struct MyALEScreen {
                 int type,
                 std::vector<int> *screen_state_atoms = nullptr,
                 const std::vector<int> *prev_screen_state_atoms = nullptr)
+      : MyALEScreen(ale.getScreen(), type, screen_state_atoms, prev_screen_state_atoms) {
+    }
+    MyALEScreen(const ALEScreen &screen,
+                int type,
+                std::vector<int> *screen_state_atoms = nullptr,
+                const std::vector<int> *prev_screen_state_atoms = nullptr)
       : type_(type),
-        screen_(ale.getScreen()) {
+        screen_(screen) {
 
-        Logger::DebugMode(-100)
+        LOGGER(Logger::DebugMode(-100))
           << "screen:"
           << " type=" << type_
           << ", height=" << screen_.height() << " (expecting " << 210 << ")" // for some reason static const int height_ not working here...
@@ -52,13 +61,13 @@ struct MyALEScreen {
         compute_features(type, screen_state_atoms, prev_screen_state_atoms);
     }
 
-    static Action random_action() {
-        return minimal_actions_[lrand48() % minimal_actions_size_];
+    static Action random_action(Random::Engine &rng) {
+        return minimal_actions_[rng.uniform(minimal_actions_size_)];
     }
-    static void reset(ALEInterface &ale) {
+    static void reset(ALEInterface &ale, Random::Engine &rng) {
         ale.reset_game();
         for( size_t k = 0; k < 100; ++k )
-            ale.act(random_action());
+            ale.act(random_action(rng));
     }
     static void fill_image(ALEInterface &ale, std::vector<pixel_t> &image) {
         const ALEScreen &screen = ale.getScreen();
@@ -72,7 +81,7 @@ struct MyALEScreen {
         background_ = std::vector<pixel_t>(width_ * height_, 0);
         num_background_pixels_ = width_ * height_;
     }
-    static void compute_background_image(ALEInterface &ale, size_t num_frames) {
+    static void compute_background_image(ALEInterface &ale, size_t num_frames, Random::Engine &rng) {
         assert((width_ == ale.getScreen().width()) && (height_ == ale.getScreen().height()));
         float start_time = Utils::read_time_in_seconds();
 
@@ -89,11 +98,11 @@ struct MyALEScreen {
         std::vector<pixel_t> reference_image(width_ * height_);
         std::vector<pixel_t> image(width_ * height_);
 
-        reset(ale);
+        reset(ale, rng);
         fill_image(ale, reference_image);
         int frameskip = ale.getInt("frame_skip");
         for( size_t k = 0; k < num_frames; k += frameskip ) {
-            if( ale.game_over() ) reset(ale);
+            if( ale.game_over() ) reset(ale, rng);
             fill_image(ale, image);
             for( size_t c = 0; c < width_; ++c ) {
                 for( size_t r = 0; r < height_; ++r ) {
@@ -103,7 +112,7 @@ struct MyALEScreen {
                     }
                 }
             }
-            ale.act(random_action());
+            ale.act(random_action(rng));
         }
 
         for( size_t c = 0; c < width_; ++c ) {
@@ -132,11 +141,38 @@ struct MyALEScreen {
         assert(num_background_pixels_ > 0);
         background_[r * width_ + c] = 0;
         --num_background_pixels_;
-        Logger::DebugMode(-100)
+        LOGGER(Logger::DebugMode(-100))
           << "background: #pixels=" << num_background_pixels_ << "/" << width_ * height_
           << std::endl;
     }
 
+    // 128-bit hash of background-subtracted screen, read as 64-bit words by
+    // two independent lanes. Background is ammended as in feature
+    // computation, so screens that hash equal yield the same features.
+    static void subtracted_screen_hash(const ALEScreen &screen, uint64_t &h1, uint64_t &h2) {
+        Profiler::Scope scope(Profiler::ScreenHash);
+        assert((width_ == screen.width()) && (height_ == screen.height()));
+        const pixel_t *pixels = screen.getArray();
+        h1 = 0x9E3779B97F4A7C15ULL;
+        h2 = 0xC2B2AE3D27D4EB4FULL;
+        for( size_t i = 0; i < width_ * height_; i += 8 ) {
+            uint64_t word = 0;
+            for( size_t j = 0; j < 8; ++j ) {
+                pixel_t p = pixels[i + j];
+                pixel_t b = background_[i + j];
+                if( p < b )
+                    ammend_background_image((i + j) / width_, (i + j) % width_);
+                else
+                    p -= b;
+                word |= uint64_t(p) << (8 * j);
+            }
+            h1 = (h1 ^ word) * 0x100000001B3ULL;
+            h1 ^= h1 >> 29;
+            h2 = (h2 + word) * 0xFF51AFD7ED558CCDULL;
+            h2 ^= h2 >> 31;
+        }
+    }
+
     const ALEScreen& get_screen() const {
         return screen_;
     }
@@ -151,19 +187,12 @@ struct MyALEScreen {
             compute_basic_features(screen_state_atoms);
             num_basic_features = screen_state_atoms->size();
             if( (type_ > 1) && (screen_state_atoms != nullptr) ) {
-                std::vector<int> basic_features(*screen_state_atoms);
-                bpros_features_bitmap_ = std::vector<bool>(num_bpros_features_, false);
-                compute_bpros_features(basic_features, *screen_state_atoms);
-                num_bpros_features = screen_state_atoms->size() - num_basic_features;
-                if( (type_ > 2) && (prev_screen_state_atoms != nullptr) ) {
-                    bprot_features_bitmap_ = std::vector<bool>(num_bprot_features_, false);
-                    compute_bprot_features(basic_features, *screen_state_atoms, *prev_screen_state_atoms);
-                    num_bprot_features = screen_state_atoms->size() - num_basic_features - num_bpros_features;
-                }
+                num_bpros_features = compute_composite_features(type_, *screen_state_atoms, prev_screen_state_atoms, bpros_features_bitmap_, bprot_features_bitmap_);
+                num_bprot_features = screen_state_atoms->size() - num_basic_features - num_bpros_features;
             }
         }
 
-        Logger::DebugMode(-100)
+        LOGGER(Logger::DebugMode(-100))
           << "screen:"
           << " #features=" << screen_state_atoms->size()
           << ", #basic=" << num_basic_features
@@ -197,6 +226,7 @@ struct MyALEScreen {
         }
     }
     void compute_basic_features(std::vector<int> *screen_state_atoms = 0) {
+        Profiler::Scope scope(Profiler::BasicFeatures);
         for( size_t c = 0; c <= width_ - 10; c += 10 ) { // 0, 10, 20, 30, 40, 50, 60, 70, 80, 90, 100, 110, 120, 130, 140, 150
             for( size_t r = 0; r <= height_ - 15; r += 15) { // 0, 15, 30, 45, 60, 75, 90, 105, 120, 135, 150, 165, 180, 195
                 compute_basic_features(c / 10, r / 15, screen_state_atoms);
@@ -204,24 +234,54 @@ struct MyALEScreen {
         }
     }
 
-    void compute_bpros_features(const std::vector<int> &basic_features, std::vector<int> &screen_state_atoms) {
+    // B-PROS atoms, and B-PROT atoms if type > 2 and atoms of previous
+    // screen are given, from the basic atoms in screen_state_atoms (which
+    // are the only atoms in it); composite atoms are appended and the
+    // number of B-PROS atoms is returned
+    static size_t compute_composite_features(int type,
+                                             std::vector<int> &screen_state_atoms,
+                                             const std::vector<int> *prev_screen_state_atoms,
+                                             std::vector<bool> &bpros_features_bitmap,
+                                             std::vector<bool> &bprot_features_bitmap) {
+        assert(type > 1);
+        std::vector<int> basic_features(screen_state_atoms);
+        bpros_features_bitmap = std::vector<bool>(num_bpros_features_, false);
+        compute_bpros_features(basic_features, screen_state_atoms, bpros_features_bitmap);
+        size_t num_bpros_features = screen_state_atoms.size() - basic_features.size();
+        if( (type > 2) && (prev_screen_state_atoms != nullptr) ) {
+            bprot_features_bitmap = std::vector<bool>(num_bprot_features_, false);
+            compute_bprot_features(basic_features, screen_state_atoms, *prev_screen_state_atoms, bprot_features_bitmap);
+        }
+        return num_bpros_features;
+    }
+    static void compute_composite_features(int type, std::vector<int> &screen_state_atoms, const std::vector<int> *prev_screen_state_atoms) {
+        std::vector<bool> bpros_features_bitmap, bprot_features_bitmap;
+        compute_composite_features(type, screen_state_atoms, prev_screen_state_atoms, bpros_features_bitmap, bprot_features_bitmap);
+    }
+
+    static void compute_bpros_features(const std::vector<int> &basic_features,
+                                       std::vector<int> &screen_state_atoms,
+                                       std::vector<bool> &bpros_features_bitmap) {
+        Profiler::Scope scope(Profiler::BprosFeatures);
         std::pair<std::pair<size_t, size_t>, pixel_t> f1, f2;
         for( size_t j = 0; j < basic_features.size(); ++j ) {
             unpack_basic_feature(basic_features[j], f1);
             for( size_t k = j; k < basic_features.size(); ++k ) {
                 unpack_basic_feature(basic_features[k], f2);
                 int pack = pack_bpros_feature(f1, f2);
-                if( !bpros_features_bitmap_[pack - num_basic_features_] ) {
-                    bpros_features_bitmap_[pack - num_basic_features_] = true;
+                if( !bpros_features_bitmap[pack - num_basic_features_] ) {
+                    bpros_features_bitmap[pack - num_basic_features_] = true;
                     screen_state_atoms.push_back(pack);
                 }
             }
         }
     }
 
-    void compute_bprot_features(const std::vector<int> &basic_features,
-                                std::vector<int> &screen_state_atoms,
-                                const std::vector<int> &prev_screen_state_atoms) {
+    static void compute_bprot_features(const std::vector<int> &basic_features,
+                                       std::vector<int> &screen_state_atoms,
+                                       const std::vector<int> &prev_screen_state_atoms,
+                                       std::vector<bool> &bprot_features_bitmap) {
+        Profiler::Scope scope(Profiler::BprotFeatures);
         std::pair<std::pair<size_t, size_t>, pixel_t> f1, f2;
         for( size_t j = 0; j < basic_features.size(); ++j ) {
             unpack_basic_feature(basic_features[j], f1);
@@ -229,8 +289,8 @@ struct MyALEScreen {
                 if( !is_basic_feature(prev_screen_state_atoms[k]) ) break; // no more basic features in vector
                 unpack_basic_feature(prev_screen_state_atoms[k], f2);
                 int pack = pack_bprot_feature(f1, f2);
-                if( !bprot_features_bitmap_[pack - num_basic_features_ - num_bpros_features_] ) {
-                    bprot_features_bitmap_[pack - num_basic_features_ - num_bpros_features_] = true;
+                if( !bprot_features_bitmap[pack - num_basic_features_ - num_bpros_features_] ) {
+                    bprot_features_bitmap[pack - num_basic_features_ - num_bpros_features_] = true;
                     screen_state_atoms.push_back(pack);
                 }
             }
@@ -3,17 +3,30 @@
 #ifndef SIM_PLANNER_H
 #define SIM_PLANNER_H
 
+#include <algorithm>
+#include <cstring>
 #include <deque>
 #include <iostream>
 #include <limits>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
+#ifdef __AVX2__
+  #include <immintrin.h>
+#endif
 
 #include "planner.h"
+#include "features.h"
+#include "feature_cache.h"
+#include "transition_cache.h"
 #include "node.h"
+#include "novelty_sketch.h"
+#include "novelty_table.h"
 #include "screen.h"
 #include "logger.h"
+#include "profiler.h"
+#include "stats.h"
 #include "utils.h"
 
 struct SimPlanner : Planner {
@@ -23,17 +36,104 @@ struct SimPlanner : Planner {
     const bool use_minimal_action_set_;
     const int simulator_budget_;
     const size_t num_tracked_atoms_;
+    const size_t memory_budget_;             // bytes (0 = unlimited)
+    const bool sketch_verify_;               // run exact tables alongside sketch
+    const bool use_transpositions_;          // prune nodes that reach states in table
+    const bool use_action_equivalence_;      // merge children that reach same state as a sibling
+    const bool use_warm_start_novelty_;      // fill novelty tables from kept tree at decision start
+    const bool warm_start_verify_;           // run cold tables alongside warm-started tables
 
     mutable size_t simulator_calls_;
+    mutable size_t num_generated_;
     mutable float sim_time_;
     mutable float sim_reset_time_;
     mutable float sim_get_set_state_time_;
 
     mutable size_t get_atoms_calls_;
+    mutable size_t derived_atoms_skipped_;   // frame repetitions found from base atoms
     mutable float get_atoms_time_;
     mutable float novel_atom_time_;
     mutable float update_novelty_time_;
 
+    // memory (in bytes) held during decision by lookahead tree, novelty
+    // tables, and the caches kept across decisions: computed at decision
+    // start (by traversal for the tree) and then updated as they change.
+    // States are accounted with a per-state size measured on first cloned
+    // state.
+    struct memory_t {
+        size_t nodes_;
+        size_t states_;
+        size_t atoms_;
+        size_t tables_;
+        size_t caches_;
+        memory_t() : nodes_(0), states_(0), atoms_(0), tables_(0), caches_(0) { }
+        size_t total() const {
+            return nodes_ + states_ + atoms_ + tables_ + caches_;
+        }
+    };
+    mutable memory_t memory_;
+    mutable size_t state_bytes_;
+    mutable bool memory_budget_hit_;
+
+    // scratch vectors for decoded atoms (see AtomSet)
+    mutable std::vector<int> atoms_scratch_;
+    mutable std::vector<int> parent_atoms_scratch_;
+
+    // approximate novelty (disabled unless sketch width > 0); when verifying,
+    // checks where the sketch prunes a node that is novel for the exact
+    // tables are counted as false prunes
+    mutable NoveltySketch sketch_;
+    mutable size_t sketch_checks_;
+    mutable size_t sketch_false_prunes_;
+
+    // screen atoms cached across decisions (disabled if size is 0); time
+    // saved by hits is estimated with the mean time of misses
+    mutable FeatureCache feature_cache_;
+    mutable size_t feature_cache_lookups_;
+    mutable size_t feature_cache_hits_;
+    mutable float feature_cache_miss_time_;
+
+    // transposition table: for each state (RAM and lives), the best node
+    // that reaches it, i.e. the shallowest one and, among those, the one
+    // with biggest path reward. A node is a duplicate if the node in the
+    // table reaches its state at the same or smaller depth with the same or
+    // bigger path reward; duplicates get no atoms and are pruned. Nodes
+    // that reach the state deeper but with more reward aren't dominated
+    // and are kept, so better paths to a state are never pruned.
+    mutable std::unordered_map<uint64_t, const Node*> transpositions_;
+    mutable size_t num_duplicates_;
+
+    // simulator transitions cached across decisions (disabled if size is 0),
+    // keyed by hash of parent state and action; hits save feature
+    // computation and, if the cache stores states, simulator calls. A hit
+    // without state defers the simulator call to when the state of the
+    // node is needed (e.g. to generate a child), so simulator calls saved
+    // are hits with state plus hits without state that are never simulated
+    mutable TransitionCache transition_cache_;
+    mutable size_t transition_cache_lookups_;
+    mutable size_t transition_cache_hits_;
+    mutable size_t transition_cache_deferred_calls_;
+
+    // action equivalence: children whose state (RAM and lives), reward,
+    // and terminal flag are those of an already generated sibling are
+    // merged into it. Counts per action are kept over all decisions, so
+    // they tell which actions tend to be equivalent for the ROM.
+    mutable size_t num_merged_children_;
+    mutable size_t action_generated_counts_[32];
+    mutable size_t action_merged_counts_[32];
+
+    // warm start: atoms of the nodes of the kept tree are added to the
+    // novelty tables at decision start. When verifying, new nodes are also
+    // checked against cold tables that only hold atoms of the nodes checked
+    // during the decision; warm-start prunes are new nodes that are not
+    // novel but would be novel without the warm start. Their expansion is
+    // saved, i.e. one simulator call per action.
+    mutable size_t num_warm_start_nodes_;
+    mutable size_t num_warm_start_updates_;
+    mutable size_t num_warm_start_prunes_;
+    mutable size_t num_warm_start_saved_calls_;
+    mutable float warm_start_time_;
+
     ALEState initial_sim_state_;
     ActionVect action_set_;
 
@@ -41,13 +141,35 @@ struct SimPlanner : Planner {
                size_t frameskip,
                bool use_minimal_action_set,
                int simulator_budget,
-               size_t num_tracked_atoms)
+               size_t num_tracked_atoms,
+               size_t memory_budget = 0,
+               size_t sketch_width = 0,
+               size_t sketch_rows = 0,
+               bool sketch_verify = false,
+               size_t feature_cache_size = 0,
+               bool use_transpositions = false,
+               size_t transition_cache_size = 0,
+               bool transition_cache_states = false,
+               bool use_action_equivalence = false,
+               bool use_warm_start_novelty = false,
+               bool warm_start_verify = false)
       : Planner(),
         sim_(sim),
         frameskip_(frameskip),
         use_minimal_action_set_(use_minimal_action_set),
         simulator_budget_(simulator_budget),
-        num_tracked_atoms_(num_tracked_atoms) {
+        num_tracked_atoms_(num_tracked_atoms),
+        memory_budget_(memory_budget),
+        sketch_verify_(sketch_verify),
+        use_transpositions_(use_transpositions),
+        use_action_equivalence_(use_action_equivalence),
+        use_warm_start_novelty_(use_warm_start_novelty),
+        warm_start_verify_(use_warm_start_novelty && warm_start_verify),
+        state_bytes_(0),
+        memory_budget_hit_(false),
+        sketch_(sketch_width, sketch_rows),
+        feature_cache_(feature_cache_size),
+        transition_cache_(transition_cache_size, transition_cache_states) {
         //static_assert(std::numeric_limits<float>::is_iec559, "IEEE 754 required");
         assert(sim_.getInt("frame_skip") == int(frameskip_));
         if( use_minimal_action_set_ )
@@ -57,18 +179,42 @@ struct SimPlanner : Planner {
         assert(sim_.getInt("frame_skip") == int(frameskip_));
         reset_game(sim_);
         get_state(sim_, initial_sim_state_);
+        for( size_t k = 0; k < 32; ++k ) {
+            action_generated_counts_[k] = 0;
+            action_merged_counts_[k] = 0;
+        }
     }
     virtual ~SimPlanner() { }
 
     void reset_stats() const {
         simulator_calls_ = 0;
+        num_generated_ = 0;
         sim_time_ = 0;
         sim_reset_time_ = 0;
         sim_get_set_state_time_ = 0;
         update_novelty_time_ = 0;
         get_atoms_calls_ = 0;
+        derived_atoms_skipped_ = 0;
         get_atoms_time_ = 0;
         novel_atom_time_ = 0;
+        memory_ = memory_t();
+        memory_.caches_ = feature_cache_.bytes() + transition_cache_.bytes();
+        memory_budget_hit_ = false;
+        sketch_checks_ = 0;
+        sketch_false_prunes_ = 0;
+        feature_cache_lookups_ = 0;
+        feature_cache_hits_ = 0;
+        feature_cache_miss_time_ = 0;
+        num_duplicates_ = 0;
+        transition_cache_lookups_ = 0;
+        transition_cache_hits_ = 0;
+        transition_cache_deferred_calls_ = 0;
+        num_merged_children_ = 0;
+        num_warm_start_nodes_ = 0;
+        num_warm_start_updates_ = 0;
+        num_warm_start_prunes_ = 0;
+        num_warm_start_saved_calls_ = 0;
+        warm_start_time_ = 0;
     }
 
     virtual float simulator_time() const {
@@ -77,23 +223,29 @@ struct SimPlanner : Planner {
     virtual size_t simulator_calls() const {
         return simulator_calls_;
     }
+    virtual size_t generated() const {
+        return num_generated_;
+    }
     virtual Action random_action() const {
-        return action_set_[lrand48() % action_set_.size()];
+        return action_set_[rng_.uniform(action_set_.size())];
     }
 
     Action random_zero_value_action(const Node *root, float discount) const {
         assert(root != 0);
-        assert((root->num_children_ > 0) && (root->first_child_ != nullptr));
+        assert(root->num_children_ > 0);
         std::vector<Action> zero_value_actions;
         for( Node *child = root->first_child_; child != nullptr; child = child->sibling_ ) {
             if( child->qvalue(discount) == 0 )
                 zero_value_actions.push_back(child->action_);
         }
+        for( size_t k = 0; k < root->num_pending_children(); ++k )
+            zero_value_actions.push_back(root->pending_action(k));
         assert(!zero_value_actions.empty());
-        return zero_value_actions[lrand48() % zero_value_actions.size()];
+        return zero_value_actions[rng_.uniform(zero_value_actions.size())];
     }
 
     float call_simulator(ALEInterface &ale, Action action) const {
+        Profiler::Scope scope(Profiler::Simulate);
         ++simulator_calls_;
         float start_time = Utils::read_time_in_seconds();
         float reward = ale.act(action);
@@ -103,16 +255,19 @@ struct SimPlanner : Planner {
     }
 
     void reset_game(ALEInterface &ale) const {
+        Profiler::Scope scope(Profiler::ResetGame);
         float start_time = Utils::read_time_in_seconds();
         ale.reset_game();
         sim_reset_time_ += Utils::read_time_in_seconds() - start_time;
     }
     void get_state(ALEInterface &ale, ALEState &ale_state) const {
+        Profiler::Scope scope(Profiler::CloneState);
         float start_time = Utils::read_time_in_seconds();
         ale_state = ale.cloneState();
         sim_get_set_state_time_ += Utils::read_time_in_seconds() - start_time;
     }
     void set_state(ALEInterface &ale, const ALEState &ale_state) const {
+        Profiler::Scope scope(Profiler::RestoreState);
         float start_time = Utils::read_time_in_seconds();
         ale.restoreState(ale_state);
         sim_get_set_state_time_ += Utils::read_time_in_seconds() - start_time;
@@ -139,76 +294,364 @@ struct SimPlanner : Planner {
     }
 
     // update info for node
-    void update_info(Node *node, int screen_features, float alpha, bool use_alpha_to_update_reward_for_death) const {
+    template<typename F>
+    void update_info(Node *node, float alpha, bool use_alpha_to_update_reward_for_death) const {
         assert(node->is_info_valid_ != 2);
         assert(node->state_ == nullptr);
         assert(node->parent_ != nullptr);
         assert((node->parent_->is_info_valid_ == 1) || (node->parent_->state_ != nullptr));
+        if( transition_cache_.enabled() && update_info_from_transition_cache<F>(node, alpha, use_alpha_to_update_reward_for_death) )
+            return;
         if( node->parent_->state_ == nullptr ) {
             // do recursion on parent
-            update_info(node->parent_, screen_features, alpha, use_alpha_to_update_reward_for_death);
+            update_info<F>(node->parent_, alpha, use_alpha_to_update_reward_for_death);
         }
         assert(node->parent_->state_ != nullptr);
+        if( node->deferred_state_ ) {
+            ++transition_cache_deferred_calls_;
+            node->deferred_state_ = false;
+        }
         set_state(sim_, *node->parent_->state_);
         float reward = call_simulator(sim_, node->action_);
         assert(reward != std::numeric_limits<float>::infinity());
         assert(reward != -std::numeric_limits<float>::infinity());
         node->state_ = new ALEState;
         get_state(sim_, *node->state_);
+        memory_.states_ += get_state_bytes(*node->state_);
         if( node->is_info_valid_ == 0 ) {
-            node->reward_ = reward;
-            node->terminal_ = terminal_state(sim_);
-            if( node->reward_ < 0 ) node->reward_ *= alpha;
-            get_atoms(node, screen_features);
-            node->ale_lives_ = get_lives(sim_);
-            if( use_alpha_to_update_reward_for_death && (node->parent_ != nullptr) && (node->parent_->ale_lives_ != -1) ) {
-                if( node->ale_lives_ < node->parent_->ale_lives_ ) {
-                    node->reward_ = -10 * alpha;
-                    //logos_ << "L" << std::flush;
-                }
+            ++num_generated_;
+            set_info(node, reward, terminal_state(sim_), get_lives(sim_), alpha, use_alpha_to_update_reward_for_death);
+            if( use_transpositions_ || use_action_equivalence_ ) {
+                node->state_hash_ = get_state_hash(sim_, node->ale_lives_);
+                check_state(node);
             }
-            node->path_reward_ = node->parent_ == nullptr ? 0 : node->parent_->path_reward_;
-            node->path_reward_ += node->reward_;
+            if( !node->duplicate_ && !node->equivalent_ ) get_atoms<F>(node);
+            if( transition_cache_.enabled() ) insert_transition<F>(node, reward);
         }
         node->is_info_valid_ = 2;
     }
 
-    // get atoms from ram or screen
-    void get_atoms(const Node *node, int screen_features) const {
-        assert(node->feature_atoms_.empty());
-        ++get_atoms_calls_;
-        if( screen_features == 0 ) { // RAM mode
-            get_atoms_from_ram(node);
-        } else {
-            get_atoms_from_screen(node, screen_features);
-            if( (node->parent_ != nullptr) && (node->parent_->feature_atoms_ == node->feature_atoms_) ) {
-                node->frame_rep_ = node->parent_->frame_rep_ + frameskip_;
-                assert((node->num_children_ == 0) && (node->first_child_ == nullptr));
+    void set_info(Node *node, float reward, bool terminal, int lives, float alpha, bool use_alpha_to_update_reward_for_death) const {
+        node->reward_ = reward;
+        node->terminal_ = terminal;
+        if( node->reward_ < 0 ) node->reward_ *= alpha;
+        node->ale_lives_ = lives;
+        if( use_alpha_to_update_reward_for_death && (node->parent_ != nullptr) && (node->parent_->ale_lives_ != -1) ) {
+            if( node->ale_lives_ < node->parent_->ale_lives_ ) {
+                node->reward_ = -10 * alpha;
+                //logos_ << "L" << std::flush;
             }
         }
-        assert((node->frame_rep_ == 0) || (screen_features > 0));
+        node->path_reward_ = node->parent_ == nullptr ? 0 : node->parent_->path_reward_;
+        node->path_reward_ += node->reward_;
     }
-    void get_atoms_from_ram(const Node *node) const {
-        assert(node->feature_atoms_.empty());
-        node->feature_atoms_ = std::vector<int>(128, 0);
-        float start_time = Utils::read_time_in_seconds();
-        const ALERAM &ram = get_ram(sim_);
-        for( size_t k = 0; k < 128; ++k ) {
-            node->feature_atoms_[k] = (k << 8) + ram.get(k);
-            assert((k == 0) || (node->feature_atoms_[k] > node->feature_atoms_[k-1]));
+
+    // transition cache
+    uint64_t get_ale_state_hash(const Node *node) const {
+        if( (node->ale_state_hash_ == 0) && (node->state_ != nullptr) ) {
+            const std::string state = node->state_->serialize();
+            uint64_t hash = Utils::mix64(state.size());
+            for( size_t k = 0; k < state.size(); k += 8 ) {
+                uint64_t word = 0;
+                memcpy(&word, state.data() + k, std::min<size_t>(8, state.size() - k));
+                hash = Utils::mix64(hash ^ word);
+            }
+            const_cast<Node*>(node)->ale_state_hash_ = hash | 1;
         }
-        get_atoms_time_ += Utils::read_time_in_seconds() - start_time;
+        return node->ale_state_hash_;
+    }
+
+    // key of transition leading to node (0 if it cannot be cached): B-PROT
+    // atoms depend on the atoms of the parent, so their fingerprint is part
+    // of the key, and the transition cannot be cached if they haven't been
+    // computed (as for the parent of a new root)
+    template<typename F>
+    uint64_t get_transition_key(const Node *node) const {
+        uint64_t parent_hash = get_ale_state_hash(node->parent_);
+        if( (parent_hash == 0) || ((F::parent_atoms_bound_ > 0) && (node->parent_->atoms_fingerprint_ == 0)) )
+            return 0;
+        uint64_t key = Utils::mix64(parent_hash ^ Utils::mix64(uint64_t(node->action_) + 1));
+        if( F::parent_atoms_bound_ > 0 )
+            key = Utils::mix64(key + node->parent_->atoms_fingerprint_);
+        return key;
+    }
+
+    // fill info (and state, if stored) of node from cached transition;
+    // if state is not stored, node is left with partial info. Returns false
+    // if transition is not cached or cannot provide what node needs.
+    template<typename F>
+    bool update_info_from_transition_cache(Node *node, float alpha, bool use_alpha_to_update_reward_for_death) const {
+        uint64_t key = get_transition_key<F>(node);
+        if( key == 0 ) return false;
+        ++transition_cache_lookups_;
+        const TransitionCache::transition_t *transition = transition_cache_.find(key);
+        if( transition == nullptr ) return false;
+        if( (node->is_info_valid_ == 1) && (transition->state_ == nullptr) ) return false;
+        // B-PROT repetitions also depend on the grandparent, so a transition
+        // cached as repetition (without atoms) may not be one for this node
+        bool repetition = (node->parent_->atoms_fingerprint_ != 0) && (node->parent_->atoms_fingerprint_ == transition->atoms_fingerprint_);
+        if( (node->is_info_valid_ == 0) && transition->atoms_.empty() && !repetition ) return false;
+        ++transition_cache_hits_;
+
+        if( transition->state_ != nullptr ) {
+            node->state_ = new ALEState(*transition->state_);
+            memory_.states_ += get_state_bytes(*node->state_);
+        }
+        node->ale_state_hash_ = transition->ale_state_hash_;
+        if( node->is_info_valid_ == 0 ) {
+            ++num_generated_;
+            set_info(node, transition->reward_, transition->terminal_, transition->lives_, alpha, use_alpha_to_update_reward_for_death);
+            if( use_transpositions_ || use_action_equivalence_ ) {
+                node->state_hash_ = transition->state_hash_;
+                check_state(node);
+            }
+            if( !node->duplicate_ && !node->equivalent_ ) {
+                node->atoms_fingerprint_ = transition->atoms_fingerprint_;
+                if( F::screen_ && repetition )
+                    mark_frame_repetition(node);
+                else
+                    node->feature_atoms_.share(transition->atoms_);
+                memory_.atoms_ += atoms_bytes(node);
+            }
+        }
+        node->deferred_state_ = node->state_ == nullptr;
+        node->is_info_valid_ = node->state_ != nullptr ? 2 : 1;
+        return true;
+    }
+
+    // cache transition of newly generated node; atoms of frame repetitions
+    // are not stored as they are those of the parent (which may be trimmed)
+    template<typename F>
+    void insert_transition(const Node *node, float reward) const {
+        uint64_t key = get_transition_key<F>(node);
+        if( (key == 0) || node->duplicate_ || node->equivalent_ ) return;
+        TransitionCache::transition_t transition;
+        transition.reward_ = reward;
+        transition.terminal_ = node->terminal_;
+        transition.lives_ = node->ale_lives_;
+        transition.ale_state_hash_ = get_ale_state_hash(node);
+        transition.state_hash_ = node->state_hash_;
+        transition.atoms_fingerprint_ = node->atoms_fingerprint_;
+        if( node->frame_rep_ == 0 ) transition.atoms_.share(node->feature_atoms_);
+        if( transition_cache_.store_states() ) transition.state_ = std::make_shared<const ALEState>(*node->state_);
+        size_t bytes = transition_cache_.bytes();
+        transition_cache_.insert(key, transition, get_state_bytes(*node->state_));
+        memory_.caches_ = memory_.caches_ - bytes + transition_cache_.bytes();
+    }
+
+    // transpositions
+    uint64_t get_state_hash(ALEInterface &ale, int lives) const {
+        const byte_t *ram = ale.getRAM().array();
+        uint64_t hash = Utils::mix64(uint64_t(uint32_t(lives)));
+        for( size_t w = 0; w < 16; ++w ) {
+            uint64_t word = 0;
+            for( size_t b = 0; b < 8; ++b )
+                word |= uint64_t(ram[8 * w + b]) << (8 * b);
+            hash = Utils::mix64(hash ^ word);
+        }
+        return hash | 1;
+    }
+
+    // mark node as equivalent to a sibling, or else as duplicate of a
+    // node in transposition table; such nodes get no atoms
+    void check_state(Node *node) const {
+        assert(node->state_hash_ != 0);
+        if( use_action_equivalence_ && (node->parent_ != nullptr) ) {
+            ++action_generated_counts_[node->action_];
+            node->equivalent_ = equivalent_sibling(node) != nullptr;
+        }
+        if( use_transpositions_ && !node->equivalent_ ) {
+            node->duplicate_ = !insert_transposition(node);
+            num_duplicates_ += node->duplicate_;
+        }
+    }
+
+    // action equivalence
+    Node* equivalent_sibling(const Node *node) const {
+        for( Node *sibling = node->parent_->first_child_; sibling != nullptr; sibling = sibling->sibling_ ) {
+            if( (sibling != node) && (sibling->state_hash_ == node->state_hash_) && !sibling->equivalent_ && (sibling->reward_ == node->reward_) && (sibling->terminal_ == node->terminal_) )
+                return sibling;
+        }
+        return nullptr;
+    }
+
+    // merge node into its equivalent sibling: node is removed from tree
+    // and its action joins the actions of the sibling
+    void merge_equivalent_child(Node *node) const {
+        assert(node->equivalent_ && (node->num_children_ == 0));
+        Node *representative = equivalent_sibling(node);
+        assert(representative != nullptr);
+        representative->equivalent_actions_ |= Node::action_bit(node->action_) | node->equivalent_actions_;
+        ++num_merged_children_;
+        ++action_merged_counts_[node->action_];
+        memory_.nodes_ -= sizeof(Node);
+        memory_.states_ -= node->state_ != nullptr ? get_state_bytes(*node->state_) : 0;
+        node->parent_->remove_child(node);
+    }
+
+    // insert node into transposition table; returns false if node is
+    // dominated by the node in table for its state
+    static bool dominates(const Node *node, const Node *other) {
+        return (node->depth_ <= other->depth_) && (node->path_reward_ >= other->path_reward_);
+    }
+    bool insert_transposition(const Node *node) const {
+        assert(node->state_hash_ != 0);
+        const Node *&entry = transpositions_[node->state_hash_];
+        if( (entry != nullptr) && (entry != node) && dominates(entry, node) )
+            return false;
+        if( (entry == nullptr) || (node->depth_ < entry->depth_) || ((node->depth_ == entry->depth_) && (node->path_reward_ > entry->path_reward_)) )
+            entry = node;
+        return true;
+    }
+
+    // rebuild transposition table from tree at decision start (depths and
+    // path rewards are those of the new decision); duplicates of nodes that
+    // are no longer in the tree are reset, so they are generated again
+    void reset_transpositions(Node *root) const {
+        transpositions_.clear();
+        if( !use_transpositions_ ) return;
+        std::vector<Node*> duplicates;
+        std::deque<Node*> q(1, root);
+        while( !q.empty() ) {
+            Node *node = q.front();
+            q.pop_front();
+            if( node->state_hash_ != 0 ) {
+                if( node->duplicate_ )
+                    duplicates.push_back(node);
+                else
+                    insert_transposition(node);
+            }
+            for( Node *child = node->first_child_; child != nullptr; child = child->sibling_ )
+                q.push_back(child);
+        }
+        for( size_t k = 0; k < duplicates.size(); ++k ) {
+            std::unordered_map<uint64_t, const Node*>::const_iterator it = transpositions_.find(duplicates[k]->state_hash_);
+            if( (it == transpositions_.end()) || !dominates(it->second, duplicates[k]) )
+                duplicates[k]->reset_info();
+        }
+    }
+
+    // hits without state of earlier decisions are not counted as deferred
+    // calls of this decision (see transition_cache_deferred_calls_)
+    void reset_deferred_states(Node *node) const {
+        if( !transition_cache_.enabled() ) return;
+        node->deferred_state_ = false;
+        for( Node *child = node->first_child_; child != nullptr; child = child->sibling_ )
+            reset_deferred_states(child);
     }
-    void get_atoms_from_screen(const Node *node, int screen_features) const {
+
+    // get atoms for node from current state of simulator
+    template<typename F>
+    void get_atoms(const Node *node) const {
         assert(node->feature_atoms_.empty());
+        Profiler::Scope scope(Profiler::GetAtoms);
+        ++get_atoms_calls_;
         float start_time = Utils::read_time_in_seconds();
-        if( (screen_features < 3) || (node->parent_ == nullptr) ) {
-            MyALEScreen screen(sim_, screen_features, &node->feature_atoms_);
+        const std::vector<int> *parent_atoms = nullptr;
+        uint64_t parent_fingerprint = 0;
+        if( F::parent_atoms_bound_ > 0 ) {
+            parent_atoms_scratch_.clear();
+            if( node->parent_ != nullptr ) {
+                node->parent_->feature_atoms_.decode(parent_atoms_scratch_, F::parent_atoms_bound_);
+                parent_atoms = &parent_atoms_scratch_;
+            }
+            parent_fingerprint = AtomSet::fingerprint(parent_atoms_scratch_);
+        }
+        if( F::screen_ && feature_cache_.enabled() ) {
+            FeatureCache::key_t screen_hash;
+            MyALEScreen::subtracted_screen_hash(sim_.getScreen(), screen_hash.h1_, screen_hash.h2_);
+            FeatureCache::key_t key = FeatureCache::key(screen_hash, parent_fingerprint);
+            ++feature_cache_lookups_;
+            const FeatureCache::value_t *cached = feature_cache_.find(key);
+            if( cached != nullptr ) {
+                ++feature_cache_hits_;
+                node->feature_atoms_.share(cached->atoms_);
+                node->atoms_fingerprint_ = cached->fingerprint_;
+            } else {
+                float miss_start_time = Utils::read_time_in_seconds();
+                compute_atoms<F>(node, parent_atoms, parent_fingerprint);
+                // repetitions hold their parent's atoms, which may be trimmed
+                if( !is_frame_repetition(node) ) {
+                    size_t bytes = feature_cache_.bytes();
+                    feature_cache_.insert(key, node->feature_atoms_, node->atoms_fingerprint_);
+                    memory_.caches_ = memory_.caches_ - bytes + feature_cache_.bytes();
+                }
+                feature_cache_miss_time_ += Utils::read_time_in_seconds() - miss_start_time;
+            }
         } else {
-            assert((screen_features == 3) && (node->parent_ != nullptr));
-            MyALEScreen screen(sim_, screen_features, &node->feature_atoms_, &node->parent_->feature_atoms_);
+            compute_atoms<F>(node, parent_atoms, parent_fingerprint);
         }
         get_atoms_time_ += Utils::read_time_in_seconds() - start_time;
+        if( F::screen_ && is_frame_repetition(node) )
+            mark_frame_repetition(node);
+        assert((node->frame_rep_ == 0) || F::screen_);
+        memory_.atoms_ += atoms_bytes(node);
+    }
+
+    // atoms are determined by base atoms and, for B-PROT, by basic atoms of
+    // parent, so in screen modes nodes whose fingerprints of these inputs
+    // match their parent's are frame repetitions: they get their parent's
+    // atoms without computing derived atoms
+    template<typename F>
+    void compute_atoms(const Node *node, const std::vector<int> *parent_atoms, uint64_t parent_fingerprint) const {
+        atoms_scratch_.clear();
+        F::compute_base_atoms(sim_, atoms_scratch_);
+        if( F::screen_ ) {
+            node->atoms_fingerprint_ = AtomSet::fingerprint(atoms_scratch_);
+            if( F::parent_atoms_bound_ > 0 )
+                node->atoms_fingerprint_ = AtomSet::fingerprint(node->atoms_fingerprint_, parent_fingerprint);
+            if( is_frame_repetition(node) ) {
+                ++derived_atoms_skipped_;
+                node->feature_atoms_.share(node->parent_->feature_atoms_);
+                return;
+            }
+        }
+        F::compute_derived_atoms(sim_, atoms_scratch_, parent_atoms);
+        node->feature_atoms_.assign(atoms_scratch_);
+    }
+
+    // after expansion, atoms of node are only read by children to compute
+    // their own atoms, so they are trimmed to parent_atoms_bound_ (released
+    // if 0). Only for planners that do not check novelty of expanded nodes
+    // again. The encoding is kept if a frame-repetition child shares it:
+    // the child would keep the full encoding alive, and it would no longer
+    // be accounted since children that share their parent's encoding are
+    // counted as 0 bytes.
+    template<typename F>
+    void trim_atoms(const Node *node) const {
+        for( const Node *child = node->first_child_; child != nullptr; child = child->sibling_ ) {
+            if( child->feature_atoms_.shares(node->feature_atoms_) )
+                return;
+        }
+        size_t bytes = atoms_bytes(node);
+        if( F::parent_atoms_bound_ > 0 )
+            node->feature_atoms_.trim(F::parent_atoms_bound_);
+        else
+            node->feature_atoms_.clear();
+        memory_.atoms_ = memory_.atoms_ - bytes + atoms_bytes(node);
+    }
+
+    bool is_frame_repetition(const Node *node) const {
+        return (node->parent_ != nullptr) && (node->atoms_fingerprint_ != 0) && (node->parent_->atoms_fingerprint_ == node->atoms_fingerprint_);
+    }
+    void mark_frame_repetition(const Node *node) const {
+        node->feature_atoms_.share(node->parent_->feature_atoms_);
+        node->frame_rep_ = node->parent_->frame_rep_ + frameskip_;
+        assert((node->num_children_ == 0) && (node->first_child_ == nullptr));
+    }
+
+    // atoms of node decoded into scratch vector (valid until next call)
+    const std::vector<int>& get_feature_atoms(const Node *node) const {
+        node->feature_atoms_.decode(atoms_scratch_);
+        return atoms_scratch_;
+    }
+
+    // bytes of atom encoding held by node (shared encodings are accounted
+    // only on first node of frame-repetition chain)
+    size_t atoms_bytes(const Node *node) const {
+        if( (node->parent_ != nullptr) && node->feature_atoms_.shares(node->parent_->feature_atoms_) )
+            return 0;
+        return node->feature_atoms_.bytes();
     }
 
     // novelty tables
@@ -224,60 +667,391 @@ struct SimPlanner : Planner {
         return !use_novelty_subtables ? 0 : logscore(node->path_reward_);
     }
 
-    std::vector<int>& get_novelty_table(const Node *node, std::map<int, std::vector<int> > &novelty_table_map, bool use_novelty_subtables) const {
+    // depth stored in table entry of type T; the largest value means
+    // unseen atom, and depths beyond it saturate
+    template<typename T>
+    static int table_depth(size_t depth) {
+        return int(std::min<size_t>(depth, std::numeric_limits<T>::max() - 1));
+    }
+
+    // tables are created on first use; their reserved size is accounted
+    // (an upper bound, as pages are only backed when touched)
+    template<typename F>
+    NoveltyTable<typename F::depth_t>& get_novelty_table(const Node *node, NoveltyTables<typename F::depth_t> &novelty_table_map, bool use_novelty_subtables) const {
         int index = get_index_for_novelty_table(node, use_novelty_subtables);
-        std::map<int, std::vector<int> >::iterator it = novelty_table_map.find(index);
-        if( it == novelty_table_map.end() ) {
-            novelty_table_map.insert(std::make_pair(index, std::vector<int>()));
-            std::vector<int> &novelty_table = novelty_table_map.at(index);
-            novelty_table = std::vector<int>(num_tracked_atoms_, std::numeric_limits<int>::max());
-            return novelty_table;
-        } else {
-            return it->second;
+        NoveltyTable<typename F::depth_t> *novelty_table = novelty_table_map.find(index);
+        if( novelty_table == nullptr ) {
+            novelty_table = &novelty_table_map.insert(index, F::num_atoms_);
+            memory_.tables_ += novelty_table->reserved_bytes();
         }
+        return *novelty_table;
     }
 
-    size_t update_novelty_table(size_t depth, const std::vector<int> &feature_atoms, std::vector<int> &novelty_table) const {
+    // fused novelty check and update in one pass over the atoms: returns the
+    // largest table entry of the atoms (the node is novel iff it is greater
+    // than depth) and, if update is true, lowers the entries of the atoms to
+    // depth, storing in num_updated the number of lowered entries
+    template<typename T>
+    int check_and_update_novelty(size_t depth, const std::vector<int> &feature_atoms, NoveltyTable<T> &novelty_table, bool update, size_t &num_updated) const {
+        Profiler::Scope scope(Profiler::NoveltyCheck);
         float start_time = Utils::read_time_in_seconds();
-        size_t first_index = 0;
-        size_t number_updated_entries = 0;
-        for( size_t k = first_index; k < feature_atoms.size(); ++k ) {
-            assert((feature_atoms[k] >= 0) && (feature_atoms[k] < int(novelty_table.size())));
-            if( int(depth) < novelty_table[feature_atoms[k]] ) {
-                novelty_table[feature_atoms[k]] = depth;
-                ++number_updated_entries;
-            }
+        if( feature_atoms.empty() ) {
+            // node without atoms is never novel (e.g. screen equal to background)
+            num_updated = 0;
+            novel_atom_time_ += Utils::read_time_in_seconds() - start_time;
+            return 0;
         }
-        update_novelty_time_ += Utils::read_time_in_seconds() - start_time;
-        return number_updated_entries;
+        int max_entry = novelty_scan(table_depth<T>(depth), &feature_atoms[0], feature_atoms.size(), novelty_table.data(), update, num_updated);
+        novel_atom_time_ += Utils::read_time_in_seconds() - start_time;
+        return max_entry;
     }
 
-    int get_novel_atom(size_t depth, const std::vector<int> &feature_atoms, const std::vector<int> &novelty_table) const {
-        float start_time = Utils::read_time_in_seconds();
-        for( size_t k = 0; k < feature_atoms.size(); ++k ) {
-            assert(feature_atoms[k] < int(novelty_table.size()));
-            if( novelty_table[feature_atoms[k]] > int(depth) ) {
-                novel_atom_time_ += Utils::read_time_in_seconds() - start_time;
-                return feature_atoms[k];
+    // scan over raw (complemented) entries of table, see NoveltyTable
+    template<typename T>
+    static int novelty_scan(int depth, const int *atoms, size_t num_atoms, T *novelty_table, bool update, size_t &num_updated) {
+        int max_entry = 0;
+        num_updated = 0;
+        for( size_t k = 0; k < num_atoms; ++k ) {
+            int entry = NoveltyTable<T>::decode(novelty_table[atoms[k]]);
+            max_entry = std::max(max_entry, entry);
+            if( update && (depth < entry) ) {
+                novelty_table[atoms[k]] = NoveltyTable<T>::encode(depth);
+                ++num_updated;
             }
         }
-        for( size_t k = 0; k < feature_atoms.size(); ++k ) {
-            if( novelty_table[feature_atoms[k]] == int(depth) ) {
-                novel_atom_time_ += Utils::read_time_in_seconds() - start_time;
-                return feature_atoms[k];
+        return max_entry;
+    }
+#ifdef __AVX2__
+    // 8 atoms per step: 32-bit gathers at scale 2 bring each 16-bit entry
+    // into the low half of its lane, where it is complemented back. AVX2 has
+    // no scatter, so the lanes that need an update (given by a compare mask)
+    // are written one at a time.
+    static int novelty_scan(int depth, const int *atoms, size_t num_atoms, uint16_t *novelty_table, bool update, size_t &num_updated) {
+        const __m256i low_half = _mm256_set1_epi32(0xFFFF);
+        const __m256i depths = _mm256_set1_epi32(depth);
+        __m256i max_entries = _mm256_setzero_si256();
+        num_updated = 0;
+        size_t k = 0;
+        for( ; k + 8 <= num_atoms; k += 8 ) {
+            __m256i indices = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(atoms + k));
+            __m256i entries = _mm256_andnot_si256(_mm256_i32gather_epi32(reinterpret_cast<const int*>(novelty_table), indices, 2), low_half);
+            max_entries = _mm256_max_epi32(max_entries, entries);
+            if( update ) {
+                int mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(entries, depths)));
+                for( ; mask != 0; mask &= mask - 1 ) {
+                    int atom = atoms[k + __builtin_ctz(mask)];
+                    if( depth < NoveltyTable<uint16_t>::decode(novelty_table[atom]) ) { // atom may repeat within the step
+                        novelty_table[atom] = NoveltyTable<uint16_t>::encode(depth);
+                        ++num_updated;
+                    }
+                }
             }
         }
+        __m128i max4 = _mm_max_epi32(_mm256_castsi256_si128(max_entries), _mm256_extracti128_si256(max_entries, 1));
+        max4 = _mm_max_epi32(max4, _mm_shuffle_epi32(max4, _MM_SHUFFLE(1, 0, 3, 2)));
+        max4 = _mm_max_epi32(max4, _mm_shuffle_epi32(max4, _MM_SHUFFLE(2, 3, 0, 1)));
+        int max_entry = _mm_cvtsi128_si32(max4);
+        size_t num_updated_tail = 0;
+        max_entry = std::max(max_entry, novelty_scan<uint16_t>(depth, atoms + k, num_atoms - k, novelty_table, update, num_updated_tail));
+        num_updated += num_updated_tail;
+        return max_entry;
+    }
+#endif
+
+    // novelty of node with the novelty tables, or with the sketch if enabled
+    template<typename F>
+    int check_and_update_novelty(const Node *node, NoveltyTables<typename F::depth_t> &novelty_table_map, bool use_novelty_subtables, bool update, size_t &num_updated) const {
+        const std::vector<int> &feature_atoms = get_feature_atoms(node);
+        if( !sketch_.enabled() ) {
+            NoveltyTable<typename F::depth_t> &novelty_table = get_novelty_table<F>(node, novelty_table_map, use_novelty_subtables);
+            return check_and_update_novelty(node->depth_, feature_atoms, novelty_table, update, num_updated);
+        }
+
+        Profiler::Scope scope(Profiler::NoveltyCheck);
+        float start_time = Utils::read_time_in_seconds();
+        int depth = table_depth<NoveltySketch::depth_t>(node->depth_);
+        int index = get_index_for_novelty_table(node, use_novelty_subtables);
+        int novelty = sketch_.check_and_update(index, depth, feature_atoms, update, num_updated);
         novel_atom_time_ += Utils::read_time_in_seconds() - start_time;
-        assert(novelty_table[feature_atoms[0]] < int(depth));
-        return feature_atoms[0];
+        if( sketch_verify_ ) {
+            NoveltyTable<typename F::depth_t> &novelty_table = get_novelty_table<F>(node, novelty_table_map, use_novelty_subtables);
+            size_t exact_num_updated = 0;
+            int exact_novelty = check_and_update_novelty(node->depth_, feature_atoms, novelty_table, update, exact_num_updated);
+            assert(novelty <= exact_novelty);
+            ++sketch_checks_;
+            sketch_false_prunes_ += (exact_novelty > depth) && (novelty <= depth);
+        }
+        return novelty;
+    }
+
+    // warm start novelty tables (or sketch) with the nodes of the tree
+    // rooted at root, in one pass at their normalized depths. A node is
+    // added if it was visited, has atoms, isn't pruned for a reason other
+    // than novelty, and its depth is in [min_depth, max_depth]; if
+    // expanded_only, it must also have children.
+    template<typename F>
+    void warm_start_novelty(const Node *root, NoveltyTables<typename F::depth_t> &novelty_table_map, bool use_novelty_subtables, int min_depth, int max_depth, bool expanded_only) const {
+        if( !use_warm_start_novelty_ ) return;
+        Profiler::Scope scope(Profiler::NoveltyUpdate);
+        float start_time = Utils::read_time_in_seconds();
+        std::deque<const Node*> q(1, root);
+        while( !q.empty() ) {
+            const Node *node = q.front();
+            q.pop_front();
+            if( node->visited_ &&
+                !node->feature_atoms_.empty() &&
+                !node->terminal_ && !node->duplicate_ && !node->equivalent_ &&
+                (!F::screen_ || (node->frame_rep_ == 0)) &&
+                (node->depth_ >= min_depth) && (node->depth_ <= max_depth) &&
+                (!expanded_only || (node->num_children_ > 0)) ) {
+                size_t num_updated = 0;
+                check_and_update_novelty<F>(node, novelty_table_map, use_novelty_subtables, true, num_updated);
+                ++num_warm_start_nodes_;
+                num_warm_start_updates_ += num_updated;
+            }
+            for( const Node *child = node->first_child_; child != nullptr; child = child->sibling_ )
+                q.push_back(child);
+        }
+        warm_start_time_ += Utils::read_time_in_seconds() - start_time;
     }
 
-    size_t num_entries(const std::vector<int> &novelty_table) const {
+    // check new node, whose novelty with the warm-started tables (or
+    // sketch) is given, against cold tables (see num_warm_start_prunes_).
+    // Cold tables are a diagnostic: their memory isn't accounted
+    template<typename F>
+    void check_warm_start_prune(const Node *node, int novelty, NoveltyTables<typename F::depth_t> &cold_table_map, bool use_novelty_subtables) const {
+        int index = get_index_for_novelty_table(node, use_novelty_subtables);
+        NoveltyTable<typename F::depth_t> *cold_table = cold_table_map.find(index);
+        if( cold_table == nullptr ) cold_table = &cold_table_map.insert(index, F::num_atoms_);
+        size_t num_updated = 0;
+        int cold_novelty = check_and_update_novelty(node->depth_, get_feature_atoms(node), *cold_table, true, num_updated);
+        int depth = sketch_.enabled() ? table_depth<NoveltySketch::depth_t>(node->depth_) : table_depth<typename F::depth_t>(node->depth_);
+        if( (novelty <= depth) && (cold_novelty > table_depth<typename F::depth_t>(node->depth_)) ) {
+            ++num_warm_start_prunes_;
+            num_warm_start_saved_calls_ += action_set_.size();
+        }
+    }
+
+    // clear sketch at start of decision
+    void reset_novelty_sketch() const {
+        if( sketch_.enabled() ) {
+            sketch_.clear();
+            memory_.tables_ += sketch_.bytes();
+        }
+    }
+
+    template<typename T>
+    size_t num_entries(const NoveltyTable<T> &novelty_table) const {
         assert(novelty_table.size() == num_tracked_atoms_);
-        size_t n = 0;
-        for( size_t k = 0; k < novelty_table.size(); ++k )
-            n += novelty_table[k] < std::numeric_limits<int>::max();
-        return n;
+        return novelty_table.num_entries();
+    }
+
+    // memory accounting
+    size_t get_state_bytes(ALEState &state) const {
+        if( state_bytes_ == 0 )
+            state_bytes_ = sizeof(ALEState) + state.serialize().size();
+        return state_bytes_;
+    }
+    void account_memory(const Node *node) const {
+        memory_.nodes_ += sizeof(Node);
+        memory_.states_ += node->state_ != nullptr ? get_state_bytes(*node->state_) : 0;
+        memory_.atoms_ += atoms_bytes(node);
+        for( Node *child = node->first_child_; child != nullptr; child = child->sibling_ )
+            account_memory(child);
+    }
+    // allocate pending child of node
+    Node* materialize_child(Node *node, Action action) const {
+        memory_.nodes_ += sizeof(Node);
+        return node->materialize(action);
+    }
+    bool memory_budget_exhausted() const {
+        if( (memory_budget_ > 0) && (memory_.total() >= memory_budget_) )
+            memory_budget_hit_ = true;
+        return memory_budget_hit_;
+    }
+
+    // stats for novelty tables and simulator
+    template<typename T>
+    void add_novelty_stats(StatsSink::Record &record, const NoveltyTables<T> &novelty_table_map) const {
+        std::map<int, std::pair<size_t, size_t> > entries;
+        for( size_t k = 0; k < novelty_table_map.indices().size(); ++k ) {
+            const NoveltyTable<T> &novelty_table = novelty_table_map.at(novelty_table_map.indices()[k]);
+            entries[novelty_table_map.indices()[k]] = std::make_pair(num_entries(novelty_table), novelty_table.size());
+        }
+        record.add("entries", entries);
+    }
+    void add_simulator_stats(StatsSink::Record &record) const {
+        record.add("sim", simulator_calls_)
+          .add("generated", num_generated_)
+          .add("simulator-time", sim_time_)
+          .add("reset-time", sim_reset_time_)
+          .add("get/set-state-time", sim_get_set_state_time_);
+    }
+    void add_atoms_stats(StatsSink::Record &record) const {
+        record.add("update-novelty-time", update_novelty_time_)
+          .add("get-atoms-calls", get_atoms_calls_)
+          .add("derived-atoms-skipped", derived_atoms_skipped_)
+          .add("get-atoms-time", get_atoms_time_)
+          .add("novel-atom-time", novel_atom_time_);
+    }
+
+    void print_sketch_stats(Logger::mode_t logger_mode) const {
+        if( !sketch_.enabled() ) return;
+        Logger::Continuation(logger_mode)
+          << " sketch=" << sketch_.rows() << "x" << sketch_.width();
+        if( sketch_verify_ ) {
+            Logger::Continuation(logger_mode)
+              << " sketch-checks=" << sketch_checks_
+              << " sketch-false-prunes=" << sketch_false_prunes_
+              << " sketch-false-prune-rate=" << (sketch_checks_ == 0 ? 0 : double(sketch_false_prunes_) / sketch_checks_);
+        }
+    }
+    void add_sketch_stats(StatsSink::Record &record) const {
+        if( !sketch_.enabled() ) return;
+        record.add("sketch-rows", sketch_.rows())
+          .add("sketch-width", sketch_.width());
+        if( sketch_verify_ ) {
+            record.add("sketch-checks", sketch_checks_)
+              .add("sketch-false-prunes", sketch_false_prunes_)
+              .add("sketch-false-prune-rate", sketch_checks_ == 0 ? 0 : double(sketch_false_prunes_) / sketch_checks_);
+        }
+    }
+
+    void print_action_equivalence_stats(Logger::mode_t logger_mode) const {
+        if( !use_action_equivalence_ ) return;
+        Logger::Continuation(logger_mode)
+          << " merged-children=" << num_merged_children_
+          << " equivalent-actions=[";
+        for( size_t k = 0; k < 32; ++k ) {
+            if( action_merged_counts_[k] > 0 )
+                Logger::Continuation(logger_mode) << k << ":" << double(action_merged_counts_[k]) / action_generated_counts_[k] << ",";
+        }
+        Logger::Continuation(logger_mode) << "]";
+    }
+    void add_action_equivalence_stats(StatsSink::Record &record) const {
+        if( !use_action_equivalence_ ) return;
+        // rates in order of action set
+        std::vector<double> rates;
+        for( size_t k = 0; k < action_set_.size(); ++k ) {
+            size_t generated = action_generated_counts_[action_set_[k]];
+            rates.push_back(generated == 0 ? 0 : double(action_merged_counts_[action_set_[k]]) / generated);
+        }
+        record.add("merged-children", num_merged_children_)
+          .add("equivalent-action-rates", rates);
+    }
+
+    void print_warm_start_stats(Logger::mode_t logger_mode) const {
+        if( !use_warm_start_novelty_ ) return;
+        Logger::Continuation(logger_mode)
+          << " warm-start-nodes=" << num_warm_start_nodes_
+          << " warm-start-updates=" << num_warm_start_updates_
+          << " warm-start-time=" << warm_start_time_;
+        if( warm_start_verify_ ) {
+            Logger::Continuation(logger_mode)
+              << " warm-start-prunes=" << num_warm_start_prunes_
+              << " warm-start-saved-sim-calls=" << num_warm_start_saved_calls_;
+        }
+    }
+    void add_warm_start_stats(StatsSink::Record &record) const {
+        if( !use_warm_start_novelty_ ) return;
+        record.add("warm-start-nodes", num_warm_start_nodes_)
+          .add("warm-start-updates", num_warm_start_updates_)
+          .add("warm-start-time", warm_start_time_);
+        if( warm_start_verify_ ) {
+            record.add("warm-start-prunes", num_warm_start_prunes_)
+              .add("warm-start-saved-sim-calls", num_warm_start_saved_calls_);
+        }
+    }
+
+    void print_transposition_stats(Logger::mode_t logger_mode) const {
+        if( !use_transpositions_ ) return;
+        Logger::Continuation(logger_mode)
+          << " duplicates=" << num_duplicates_
+          << " transpositions=" << transpositions_.size();
+    }
+    void add_transposition_stats(StatsSink::Record &record) const {
+        if( !use_transpositions_ ) return;
+        record.add("duplicates", num_duplicates_)
+          .add("transpositions", transpositions_.size());
+    }
+
+    float feature_cache_time_saved() const {
+        size_t misses = feature_cache_lookups_ - feature_cache_hits_;
+        return misses == 0 ? 0 : feature_cache_hits_ * feature_cache_miss_time_ / misses;
+    }
+    void print_feature_cache_stats(Logger::mode_t logger_mode) const {
+        if( !feature_cache_.enabled() || (feature_cache_lookups_ == 0) ) return;
+        Logger::Continuation(logger_mode)
+          << " feature-cache-lookups=" << feature_cache_lookups_
+          << " feature-cache-hits=" << feature_cache_hits_
+          << " feature-cache-hit-rate=" << double(feature_cache_hits_) / feature_cache_lookups_
+          << " feature-cache-time-saved=" << feature_cache_time_saved()
+          << " feature-cache-entries=" << feature_cache_.size() << "/" << feature_cache_.capacity();
+    }
+    void add_feature_cache_stats(StatsSink::Record &record) const {
+        if( !feature_cache_.enabled() || (feature_cache_lookups_ == 0) ) return;
+        record.add("feature-cache-lookups", feature_cache_lookups_)
+          .add("feature-cache-hits", feature_cache_hits_)
+          .add("feature-cache-hit-rate", double(feature_cache_hits_) / feature_cache_lookups_)
+          .add("feature-cache-time-saved", feature_cache_time_saved())
+          .add("feature-cache-entries", feature_cache_.size());
+    }
+
+    void print_transition_cache_stats(Logger::mode_t logger_mode) const {
+        if( !transition_cache_.enabled() || (transition_cache_lookups_ == 0) ) return;
+        Logger::Continuation(logger_mode)
+          << " transition-cache-lookups=" << transition_cache_lookups_
+          << " transition-cache-hits=" << transition_cache_hits_
+          << " transition-cache-hit-rate=" << double(transition_cache_hits_) / transition_cache_lookups_
+          << " transition-cache-saved-sim-calls=" << transition_cache_saved_calls()
+          << " transition-cache-entries=" << transition_cache_.size() << "/" << transition_cache_.capacity();
+    }
+    void add_transition_cache_stats(StatsSink::Record &record) const {
+        if( !transition_cache_.enabled() || (transition_cache_lookups_ == 0) ) return;
+        record.add("transition-cache-lookups", transition_cache_lookups_)
+          .add("transition-cache-hits", transition_cache_hits_)
+          .add("transition-cache-hit-rate", double(transition_cache_hits_) / transition_cache_lookups_)
+          .add("transition-cache-saved-sim-calls", transition_cache_saved_calls())
+          .add("transition-cache-entries", transition_cache_.size());
+    }
+    size_t transition_cache_saved_calls() const {
+        return transition_cache_hits_ - transition_cache_deferred_calls_;
+    }
+
+    // tables are reported with their resident bytes, while memory-total
+    // (used for the budget) holds their reserved bytes
+    template<typename T>
+    void print_memory_stats(Logger::mode_t logger_mode, const NoveltyTables<T> &novelty_table_map) const {
+        Logger::Continuation(logger_mode)
+          << " memory-nodes=" << memory_.nodes_
+          << " memory-states=" << memory_.states_
+          << " memory-atoms=" << memory_.atoms_
+          << " memory-caches=" << memory_.caches_
+          << " memory-tables=[";
+        for( size_t k = 0; k < novelty_table_map.indices().size(); ++k ) {
+            int index = novelty_table_map.indices()[k];
+            Logger::Continuation(logger_mode) << index << ":" << novelty_table_map.at(index).resident_bytes() << ",";
+        }
+        Logger::Continuation(logger_mode)
+          << "]"
+          << " memory-total=" << memory_.total()
+          << " memory-budget-hit=" << memory_budget_hit_
+          << " peak-rss-kb=" << Utils::peak_rss_in_kb()
+          << std::endl;
+    }
+    template<typename T>
+    void add_memory_stats(StatsSink::Record &record, const NoveltyTables<T> &novelty_table_map) const {
+        std::vector<size_t> tables;
+        for( size_t k = 0; k < novelty_table_map.indices().size(); ++k )
+            tables.push_back(novelty_table_map.at(novelty_table_map.indices()[k]).resident_bytes());
+        record.add("memory-nodes", memory_.nodes_)
+          .add("memory-states", memory_.states_)
+          .add("memory-atoms", memory_.atoms_)
+          .add("memory-caches", memory_.caches_)
+          .add("memory-tables", tables)
+          .add("memory-total", memory_.total())
+          .add("memory-budget-hit", memory_budget_hit_)
+          .add("peak-rss-kb", Utils::peak_rss_in_kb());
     }
 
     // prefix
@@ -300,25 +1074,19 @@ struct SimPlanner : Planner {
     }
 
     // generate states along given branch
+    template<typename F>
     void generate_states_along_branch(Node *node,
                                       const std::deque<Action> &branch,
-                                      int screen_features,
                                       float alpha,
                                       bool use_alpha_to_update_reward_for_death) const {
         for( size_t pos = 0; pos < branch.size(); ++pos ) {
             if( node->state_ == nullptr ) {
                 assert(node->is_info_valid_ == 1);
-                update_info(node, screen_features, alpha, use_alpha_to_update_reward_for_death);
+                update_info<F>(node, alpha, use_alpha_to_update_reward_for_death);
             }
 
-            Node *selected = nullptr;
-            for( Node *child = node->first_child_; child != nullptr; child = child->sibling_ ) {
-                if( child->action_ == branch[pos] ) {
-                    selected = child;
-                    break;
-                }
-            }
-            assert(selected != nullptr);
+            Node *selected = node->child(branch[pos]);
+            if( selected == nullptr ) selected = materialize_child(node, branch[pos]);
             node = selected;
         }
     }
@@ -0,0 +1,7 @@
+// (c) 2017 Blai Bonet
+
+#include "stats.h"
+
+std::ostream* StatsSink::output_stream_ = nullptr;
+int StatsSink::episode_ = 0;
+
@@ -0,0 +1,166 @@
+// (c) 2017 Blai Bonet
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Machine-readable stats stream. Each record is one JSON object per line
+// (NDJSON) whose fields are fixed for each record type:
+//
+//   {"type":"decision","episode":E,"planner":P,...}  one per call to get_branch()
+//   {"type":"step","episode":E,...}                   one per executed action
+//   {"type":"episode","episode":E,...}                one per episode
+//
+// Decision records contain every counter printed by the planner's
+// print_stats(), step and episode records every field of the step-stats
+// and episode-stats lines.
+
+class StatsSink {
+  public:
+    class Record {
+      public:
+        Record(const std::string &type) : buffer_("{") {
+            add("type", type);
+            add("episode", StatsSink::episode());
+        }
+
+        Record& add(const std::string &key, const std::string &value) {
+            open_field(key);
+            buffer_ += '"';
+            for( size_t k = 0; k < value.size(); ++k ) {
+                char c = value[k];
+                if( (c == '"') || (c == '\\') ) {
+                    buffer_ += '\\';
+                    buffer_ += c;
+                } else if( (unsigned char)c < 0x20 ) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+                    buffer_ += escaped;
+                } else {
+                    buffer_ += c;
+                }
+            }
+            buffer_ += '"';
+            return *this;
+        }
+        Record& add(const std::string &key, const char *value) {
+            return add(key, std::string(value));
+        }
+        Record& add(const std::string &key, bool value) {
+            open_field(key);
+            buffer_ += value ? "true" : "false";
+            return *this;
+        }
+        Record& add(const std::string &key, int value) {
+            open_field(key);
+            buffer_ += std::to_string(value);
+            return *this;
+        }
+        Record& add(const std::string &key, size_t value) {
+            open_field(key);
+            buffer_ += std::to_string(value);
+            return *this;
+        }
+        Record& add(const std::string &key, double value) {
+            open_field(key);
+            append_number(value);
+            return *this;
+        }
+        Record& add(const std::string &key, float value) {
+            return add(key, double(value));
+        }
+        template<typename T>
+        Record& add(const std::string &key, const std::vector<T> &values) {
+            open_field(key);
+            buffer_ += '[';
+            for( size_t k = 0; k < values.size(); ++k ) {
+                if( k > 0 ) buffer_ += ',';
+                append_number(double(values[k]));
+            }
+            buffer_ += ']';
+            return *this;
+        }
+
+        // value already encoded as JSON (e.g. nested object)
+        Record& add_json(const std::string &key, const std::string &json) {
+            open_field(key);
+            buffer_ += json;
+            return *this;
+        }
+
+        // map from novelty subtable index to pair (#entries, size)
+        Record& add(const std::string &key, const std::map<int, std::pair<size_t, size_t> > &tables) {
+            open_field(key);
+            buffer_ += '[';
+            for( std::map<int, std::pair<size_t, size_t> >::const_iterator it = tables.begin(); it != tables.end(); ++it ) {
+                if( it != tables.begin() ) buffer_ += ',';
+                buffer_ += "{\"index\":" + std::to_string(it->first)
+                  + ",\"entries\":" + std::to_string(it->second.first)
+                  + ",\"size\":" + std::to_string(it->second.second) + "}";
+            }
+            buffer_ += ']';
+            return *this;
+        }
+
+        std::string str() const {
+            return buffer_ + "}";
+        }
+
+      private:
+        std::string buffer_;
+
+        void open_field(const std::string &key) {
+            if( buffer_.size() > 1 ) buffer_ += ',';
+            buffer_ += '"' + key + "\":";
+        }
+        void append_number(double value) {
+            if( std::isfinite(value) ) {
+                char number[32];
+                snprintf(number, sizeof(number), "%.9g", value);
+                buffer_ += number;
+            } else {
+                buffer_ += "null"; // JSON has no representation for inf/nan
+            }
+        }
+    };
+
+  public:
+    static void set_output_stream(std::ostream &output_stream) {
+        StatsSink::output_stream_ = &output_stream;
+    }
+    static bool available() {
+        return StatsSink::output_stream_ != nullptr;
+    }
+    static std::ostream& output_stream() {
+        return *StatsSink::output_stream_;
+    }
+
+    static void set_episode(int episode) {
+        StatsSink::episode_ = episode;
+    }
+    static int episode() {
+        return StatsSink::episode_;
+    }
+
+    static void write(const Record &record) {
+        if( StatsSink::available() )
+            *StatsSink::output_stream_ << record.str() << '\n';
+    }
+    static void flush() {
+        if( StatsSink::available() )
+            StatsSink::output_stream_->flush();
+    }
+
+  protected:
+    static std::ostream *output_stream_;
+    static int episode_;
+};
+
+#endif
+
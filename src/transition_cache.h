@@ -0,0 +1,110 @@
+// (c) 2017 Blai Bonet
+
+#ifndef TRANSITION_CACHE_H
+#define TRANSITION_CACHE_H
+
+#include <cassert>
+#include <list>
+#include <memory>
+#include <stdint.h>
+#include <unordered_map>
+#include <utility>
+#include <ale_interface.hpp>
+
+#include "atom_set.h"
+
+// Bounded LRU cache of simulator transitions, kept across decisions. Keys
+// are hashes of the serialized ALE state of the parent, the action, and
+// (for B-PROT) the fingerprint of the parent atoms. Values hold what
+// update_info() gets from the simulator and the feature extraction; the
+// successor state is stored only if requested, otherwise a hit fills the
+// node's info and leaves its state to be generated when needed (as with
+// partial lookahead caching). Heap bytes of entries are kept up to date
+// on insertion and eviction; stored states are accounted with a per-state
+// size given by the caller (all states of a ROM have the same size).
+
+class TransitionCache {
+  public:
+    struct transition_t {
+        float reward_;                       // reward returned by simulator
+        bool terminal_;
+        int lives_;
+        uint64_t ale_state_hash_;            // hash of successor ALE state
+        uint64_t state_hash_;                // hash of RAM and lives (0 = none)
+        AtomSet atoms_;                      // empty for frame repetitions
+        uint64_t atoms_fingerprint_;
+        std::shared_ptr<const ALEState> state_; // successor (if stored)
+        transition_t()
+          : reward_(0), terminal_(false), lives_(-1),
+            ale_state_hash_(0), state_hash_(0), atoms_fingerprint_(0) {
+        }
+    };
+
+    TransitionCache(size_t capacity, bool store_states)
+      : capacity_(capacity),
+        store_states_(store_states),
+        bytes_(0) {
+    }
+
+    bool enabled() const {
+        return capacity_ > 0;
+    }
+    size_t capacity() const {
+        return capacity_;
+    }
+    bool store_states() const {
+        return store_states_;
+    }
+    size_t size() const {
+        return entries_.size();
+    }
+    // heap bytes of cached transitions, atoms, and states
+    size_t bytes() const {
+        return bytes_;
+    }
+
+    // cached transition for key (nullptr if not cached); a hit becomes the
+    // most recently used entry
+    const transition_t* find(uint64_t key) {
+        index_t::iterator it = index_.find(key);
+        if( it == index_.end() ) return nullptr;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return &it->second->second;
+    }
+
+    // insert (or replace) transition for key; state_bytes is the size of
+    // a stored state
+    void insert(uint64_t key, const transition_t &transition, size_t state_bytes) {
+        assert(enabled());
+        index_t::iterator it = index_.find(key);
+        if( it != index_.end() ) {
+            bytes_ -= entry_bytes(it->second->second, state_bytes);
+            entries_.erase(it->second);
+            index_.erase(it);
+        } else if( entries_.size() == capacity_ ) {
+            bytes_ -= entry_bytes(entries_.back().second, state_bytes);
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+        entries_.push_front(std::make_pair(key, transition));
+        index_[key] = entries_.begin();
+        bytes_ += entry_bytes(transition, state_bytes);
+    }
+
+  private:
+    typedef std::list<std::pair<uint64_t, transition_t> > list_t;
+    typedef std::unordered_map<uint64_t, list_t::iterator> index_t;
+
+    static size_t entry_bytes(const transition_t &transition, size_t state_bytes) {
+        return sizeof(transition_t) + transition.atoms_.bytes() + (transition.state_ != nullptr ? state_bytes : 0);
+    }
+
+    const size_t capacity_;                  // max #entries (0 = disabled)
+    const bool store_states_;
+    list_t entries_;                         // most recently used first
+    index_t index_;
+    size_t bytes_;
+};
+
+#endif
+
@@ -3,7 +3,9 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stdint.h>
 #include <stdio.h>
+#include <string>
 #include <sys/resource.h>
 #include <sys/time.h>
 
@@ -32,16 +34,57 @@ inline float read_time_in_seconds(bool add_stime = true) {
     return time;
 }
 
-inline std::string normal() { return "\x1B[0m"; }
-inline std::string red() { return "\x1B[31;1m"; }
-inline std::string green() { return "\x1B[32;1m"; }
-inline std::string yellow() { return "\x1B[33;1m"; }
-inline std::string blue() { return "\x1B[34;1m"; }
-inline std::string magenta() { return "\x1B[35;1m"; }
-inline std::string cyan() { return "\x1B[36;1m"; }
-inline std::string error() { return "\x1B[31;1merror: \x1B[0m"; }
-inline std::string warning() { return "\x1B[35;1mwarning: \x1B[0m"; }
-inline std::string internal_error() { return "\x1B[31;1minternal error: \x1B[0m"; }
+// splitmix64 finalizer
+inline uint64_t mix64(uint64_t h) {
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    return h ^ (h >> 31);
+}
+
+// peak resident set size (in KB) since start or since last call to reset_peak_rss()
+inline size_t peak_rss_in_kb() {
+    FILE *fp = fopen("/proc/self/status", "r");
+    if( fp != nullptr ) {
+        char line[256];
+        size_t kb = 0;
+        while( fgets(line, sizeof(line), fp) != nullptr ) {
+            if( sscanf(line, "VmHWM: %zu kB", &kb) == 1 ) break;
+        }
+        fclose(fp);
+        if( kb > 0 ) return kb;
+    }
+    struct rusage r_usage;
+    getrusage(RUSAGE_SELF, &r_usage);
+    return r_usage.ru_maxrss;
+}
+
+// reset peak resident set size to current size (best effort, linux only)
+inline bool reset_peak_rss() {
+    FILE *fp = fopen("/proc/self/clear_refs", "w");
+    if( fp == nullptr ) return false;
+    bool status = fputs("5", fp) >= 0;
+    return (fclose(fp) == 0) && status;
+}
+
+// ANSI escape sequences for terminal colors (also used by Logger)
+constexpr const char *ansi_normal = "\x1B[0m";
+constexpr const char *ansi_red = "\x1B[31;1m";
+constexpr const char *ansi_green = "\x1B[32;1m";
+constexpr const char *ansi_yellow = "\x1B[33;1m";
+constexpr const char *ansi_blue = "\x1B[34;1m";
+constexpr const char *ansi_magenta = "\x1B[35;1m";
+constexpr const char *ansi_cyan = "\x1B[36;1m";
+
+inline std::string normal() { return ansi_normal; }
+inline std::string red() { return ansi_red; }
+inline std::string green() { return ansi_green; }
+inline std::string yellow() { return ansi_yellow; }
+inline std::string blue() { return ansi_blue; }
+inline std::string magenta() { return ansi_magenta; }
+inline std::string cyan() { return ansi_cyan; }
+inline std::string error() { return red() + "error: " + normal(); }
+inline std::string warning() { return magenta() + "warning: " + normal(); }
+inline std::string internal_error() { return red() + "internal error: " + normal(); }
 
 inline std::string cmdline(int argc, const char *argv[]) {
     std::string cmd = argv[0];